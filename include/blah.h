@@ -11,10 +11,14 @@
 	
 #include "blah/drawing/batch.h"
 #include "blah/drawing/spritefont.h"
+#include "blah/drawing/spritesheet.h"
 #include "blah/drawing/subtexture.h"
 
 #include "blah/graphics/blend.h"
 #include "blah/graphics/framebuffer.h"
+#include "blah/graphics/framebufferpool.h"
+#include "blah/graphics/residency.h"
+#include "blah/graphics/capture.h"
 #include "blah/graphics/material.h"
 #include "blah/graphics/mesh.h"
 #include "blah/graphics/renderpass.h"
@@ -25,6 +29,8 @@
 #include "blah/images/aseprite.h"
 #include "blah/images/font.h"
 #include "blah/images/image.h"
+#include "blah/images/imageloader.h"
+#include "blah/images/imageops.h"
 #include "blah/images/packer.h"
 
 #include "blah/input/input.h"
@@ -50,6 +56,7 @@
 	
 #include "blah/streams/bufferstream.h"
 #include "blah/streams/filestream.h"
+#include "blah/streams/inflatestream.h"
 #include "blah/streams/memorystream.h"
 #include "blah/streams/stream.h"
 #include "blah/streams/endian.h"
\ No newline at end of file
@@ -40,6 +40,9 @@ namespace Blah
 		bool instancing = false;
 		bool origin_bottom_left = false;
 		int max_texture_size = 0;
+
+		// R textures are sampled as (r, r, r, r), rather than (r, 0, 0, 1)
+		bool red_swizzle = false;
 	};
 
 	class FrameBuffer;
@@ -190,7 +190,7 @@ namespace Blah
 			uint8_t mult;
 			uint8_t wash;
 			uint8_t fill;
-			uint8_t pad;
+			uint8_t sdf;
 		};
 
 		struct DrawBatch
@@ -221,6 +221,7 @@ namespace Blah
 		ColorMode				m_color_mode;
 		uint8_t					m_tex_mult;
 		uint8_t					m_tex_wash;
+		uint8_t					m_tex_sdf;
 		DrawBatch				m_batch;
 		Vector<Vertex>			m_vertices;
 		Vector<uint32_t>		m_indices;
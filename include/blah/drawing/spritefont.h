@@ -4,11 +4,11 @@
 #include <blah/containers/vector.h>
 #include <blah/drawing/subtexture.h>
 #include <blah/math/vec2.h>
-#include <unordered_map>
 
 namespace Blah
 {
 	class Font;
+	class Stream;
 
 	class SpriteFont
 	{
@@ -20,12 +20,49 @@ namespace Blah
 			Vec2 offset;
 		};
 	private:
-		// charset & kerning maps
-		std::unordered_map<uint32_t, Character> m_characters;
-		std::unordered_map<uint64_t, float> m_kerning;
+		struct Entry
+		{
+			uint32_t codepoint = 0;
+
+			// whether any kerning pair starts with this character
+			bool kerning = false;
+
+			Character character;
+		};
+
+		struct Kerning
+		{
+			uint64_t pair;
+			float value;
+		};
+
+		// charset & kerning (sorted by pair)
+		// Characters are stored densely, and found through a table indexed directly by codepoint
+		// for the first few alphabets, or an open addressing table for the rest.
+		// (mutable, as dynamic fonts fill them in as they're requested)
+		mutable Vector<Entry> m_characters;
+		mutable Vector<int> m_direct;
+		mutable Vector<int> m_table;
+		Vector<Kerning> m_kerning;
 
 		// built texture
-		Vector<TextureRef> m_atlas;
+		mutable Vector<TextureRef> m_atlas;
+
+		// glyph cache state of dynamic fonts
+		struct Dynamic;
+		Dynamic* m_dynamic = nullptr;
+
+		// glyphs of a font being built, between rasterizing them and creating the textures
+		struct Atlas;
+
+		void build_atlas(const Font& font, float size, const uint32_t* charset, int sdf_padding);
+		void begin_atlas(Atlas& atlas, const Font& font, float size, const uint32_t* charset, int sdf_padding);
+		void pack_atlas(Atlas& atlas);
+		void end_atlas(Atlas& atlas);
+		int find_kerning(uint64_t pair) const;
+		int find_index(uint32_t codepoint) const;
+		int insert(uint32_t codepoint) const;
+		const Character& find(uint32_t codepoint, bool rasterize) const;
 
 	public:
 		static const uint32_t* ASCII;
@@ -36,6 +73,10 @@ namespace Blah
 		float descent;
 		float line_gap;
 
+		// When above 0, the glyphs are signed distance fields covering this many pixels
+		// on either side of their outline, and Batch draws them crisply at any size
+		int sdf_padding;
+
 		// Note:
 		// charset is a list of range pairs, until a 0 terminator (ex. 32,128,0)
 
@@ -56,6 +97,8 @@ namespace Blah
 		float height() const { return ascent - descent; }
 		float line_height() const { return ascent - descent + line_gap; }
 
+		// The atlas pages, which are single-channel (R) textures holding each glyph's coverage when
+		// the renderer samples them as (r, r, r, r) (see RendererFeatures::red_swizzle), and RGBA otherwise
 		const Vector<TextureRef>& textures() { return m_atlas; }
 
 		float width_of(const String& text) const;
@@ -65,12 +108,57 @@ namespace Blah
 		void build(const char* file, float size, const uint32_t* charset);
 		void build(const Font& font, float size, const uint32_t* charset);
 
+		// Builds the atlas out of signed distance fields, which are generated in parallel.
+		// `size` only needs to be large enough to keep the glyphs' details.
+		void build_sdf(const char* file, float size, const uint32_t* charset, int padding = 4);
+		void build_sdf(const Font& font, float size, const uint32_t* charset, int padding = 4);
+
+		// A font to build with `build_all`
+		struct BuildInfo
+		{
+			SpriteFont* font = nullptr;
+			const Font* source = nullptr;
+			float size = 0;
+			const uint32_t* charset = nullptr;
+
+			// Builds signed distance fields when above 0
+			int sdf_padding = 0;
+		};
+
+		// Builds several fonts at once, rasterizing all of their glyphs across the worker
+		// threads together and packing each font in parallel. Textures are created on the
+		// calling thread, and the source Fonts must stay valid until this returns.
+		static void build_all(const BuildInfo* fonts, int count);
+
+		// Builds an empty font that rasterizes characters the first time they're requested,
+		// and caches them in atlas pages of `page_size`. Once `max_pages` are full, the least
+		// recently used characters are evicted to make room. The Font is kept until disposed.
+		void build_dynamic(const char* file, float size, int page_size = 1024, int max_pages = 1, int sdf_padding = 0);
+		void build_dynamic(Font&& font, float size, int page_size = 1024, int max_pages = 1, int sdf_padding = 0);
+
+		// Returns true if the font caches characters as they're requested
+		bool is_dynamic() const { return m_dynamic != nullptr; }
+
+		// Caches every character of the text ahead of time, for dynamic fonts
+		void prepare(const String& text) const;
+
+		// Saves the metrics, characters, kerning and atlas pixels, so the font can be loaded
+		// without building it again. The atlas is read back from its textures, and stored
+		// with one byte per pixel when it's single-channel.
+		bool save(const char* file, bool compressed = true) const;
+		bool save(Stream& stream, bool compressed = true) const;
+
+		// Loads a font saved with `save`. Returns false, leaving the font as-is, if it's invalid.
+		bool load(const char* file);
+		bool load(Stream& stream);
+
 		float get_kerning(uint32_t codepoint0, uint32_t codepoint1) const;
 		void set_kerning(uint32_t codepoint0, uint32_t codepoint1, float kerning);
 
-		Character& get_character(uint32_t codepoint) { return m_characters[codepoint]; }
+		// Note that adding characters (or requesting new ones from dynamic fonts) moves them in memory
+		Character& get_character(uint32_t codepoint);
 		const Character& get_character(uint32_t codepoint) const;
-		Character& operator[](uint32_t codepoint) { return m_characters[codepoint]; }
+		Character& operator[](uint32_t codepoint);
 		const Character& operator[](uint32_t codepoint) const;
 	};
 }
\ No newline at end of file
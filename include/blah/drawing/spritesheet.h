@@ -0,0 +1,119 @@
+#pragma once
+#include <blah/containers/str.h>
+#include <blah/containers/vector.h>
+#include <blah/drawing/subtexture.h>
+#include <blah/images/aseprite.h>
+#include <blah/images/packer.h>
+#include <blah/math/rectI.h>
+#include <blah/math/point.h>
+#include <unordered_map>
+
+namespace Blah
+{
+	// Packs the frames of Aseprite files into texture atlases, along with their animations.
+	// Frames are trimmed and hashed, so identical frames (including linked cels) are only packed once.
+	class SpriteSheet
+	{
+	public:
+		struct Frame
+		{
+			// Index into `subtextures`. Identical frames drawn at the same offset share one.
+			int subtexture = -1;
+
+			// Duration in seconds
+			float duration = 0;
+		};
+
+		struct Animation
+		{
+			String name;
+			Aseprite::LoopDirections loops = Aseprite::LoopDirections::Forward;
+			Vector<Frame> frames;
+		};
+
+		struct Slice
+		{
+			String name;
+			int frame = 0;
+			RectI bounds;
+			bool has_pivot = false;
+			Point pivot;
+		};
+
+		struct Sprite
+		{
+			String name;
+			int width = 0;
+			int height = 0;
+
+			// Every frame in the file, followed by one Animation per tag
+			Vector<Frame> frames;
+			Vector<Animation> animations;
+			Vector<Slice> slices;
+
+			const Animation* get_animation(const String& name) const;
+			const Slice* get_slice(const String& name) const;
+		};
+
+		// Settings used to pack the frames. Rotation is always turned off, as
+		// subtextures can't be drawn rotated.
+		Packer packer;
+
+		Vector<Sprite> sprites;
+		Vector<Subtexture> subtextures;
+		Vector<TextureRef> textures;
+
+		SpriteSheet();
+		SpriteSheet(const SpriteSheet&) = delete;
+		SpriteSheet& operator=(const SpriteSheet&) = delete;
+		SpriteSheet(SpriteSheet&& src) noexcept;
+		SpriteSheet& operator=(SpriteSheet&& src) noexcept;
+
+		// Adds every frame of the Aseprite file as a Sprite with the given name.
+		// Lazily loaded files are composited one frame at a time.
+		void add(const String& name, const Aseprite& aseprite);
+
+		// Packs the frames added so far, and creates the textures and subtextures
+		void build();
+
+		// Finds a Sprite by name
+		const Sprite* get(const String& name) const;
+
+		// Gets the subtexture of a frame
+		const Subtexture& subtexture(const Frame& frame) const { return subtextures[frame.subtexture]; }
+
+		// Gets the number of unique images that were packed
+		int unique_count() const { return m_unique_count; }
+
+		void clear();
+
+	private:
+		// where a subtexture is drawn from, until the atlas is built
+		struct Placement
+		{
+			uint64_t id;
+			RectI frame;
+
+			bool operator==(const Placement& rhs) const { return id == rhs.id && frame == rhs.frame; }
+		};
+
+		struct PlacementHash
+		{
+			size_t operator()(const Placement& it) const;
+		};
+
+		// an image added to the packer, and the index of its packer entry
+		struct Unique
+		{
+			uint64_t id;
+			int entry;
+		};
+
+		Vector<Placement> m_placements;
+		int m_unique_count = 0;
+
+		// unique images by the hash of their trimmed pixels, which are compared on a match
+		std::unordered_map<uint64_t, Vector<Unique>> m_unique;
+		std::unordered_map<Placement, int, PlacementHash> m_subtextures;
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <inttypes.h>
+#include <blah/containers/vector.h>
+
+namespace Blah
+{
+	class Stream;
+
+	// Records every RenderPass to a Stream, along with everything needed to draw it again:
+	// Shaders, Mesh uploads, Texture contents (deduplicated by hash), FrameBuffers, clears,
+	// Material values and render state. The capture can then be replayed without any
+	// of the game logic that produced it, which makes it useful as a rendering benchmark.
+	namespace Capture
+	{
+		struct PassTiming
+		{
+			// The frame the RenderPass was captured in
+			int frame = 0;
+
+			// The number of indices drawn by the RenderPass
+			int64_t index_count = 0;
+
+			// The number of instances drawn by the RenderPass
+			int64_t instance_count = 0;
+
+			// Time spent submitting the RenderPass to the graphics backend
+			uint64_t microseconds = 0;
+		};
+
+		struct ReplayStats
+		{
+			// Number of frames replayed
+			int frames = 0;
+
+			// Number of RenderPasses replayed
+			int passes = 0;
+
+			// Number of RenderPasses that couldn't be replayed
+			int skipped = 0;
+
+			// Total time spent submitting RenderPasses
+			uint64_t render_microseconds = 0;
+
+			// Total time spent replaying, including resource creation and uploads
+			uint64_t total_microseconds = 0;
+
+			// Timing of every replayed RenderPass, in order
+			Vector<PassTiming> passes_timing;
+		};
+
+		// Begins capturing to the given Stream, which must stay open until `end` is called.
+		// Textures are read back from the GPU the first time they're drawn with, and later
+		// region uploads are recorded as they happen. Meshes must be uploaded while the
+		// capture is running to be recorded.
+		bool begin(Stream& stream);
+
+		// Ends the current capture
+		void end();
+
+		// Returns true if a capture is running
+		bool is_capturing();
+
+		// Replays a capture as fast as possible on the current graphics backend.
+		// Passes are submitted back to back, without presenting, so the timings
+		// are CPU submission times and don't wait on the GPU.
+		bool replay(Stream& stream, ReplayStats* stats = nullptr);
+	}
+}
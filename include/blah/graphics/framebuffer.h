@@ -35,8 +35,8 @@ namespace Blah
 		FrameBuffer& operator=(const FrameBuffer&) = delete;
 		FrameBuffer& operator=(FrameBuffer&&) = delete;
 
-		// Default Destructor
-		virtual ~FrameBuffer() = default;
+		// Destructor
+		virtual ~FrameBuffer();
 
 		// Creates a new FrameBuffer with a single Color attachment
 		// If the FrameBuffer creation fails, it will return an invalid FrameBufferRef.
@@ -0,0 +1,67 @@
+#pragma once
+#include <inttypes.h>
+#include <blah/graphics/framebuffer.h>
+#include <blah/containers/vector.h>
+
+namespace Blah
+{
+	// A pool of temporary FrameBuffers, useful for multi-pass effects like blur or bloom chains.
+	// Requested FrameBuffers are matched by size and attachment formats, and are handed back to
+	// the pool at the end of every frame instead of being destroyed. FrameBuffers that go unused
+	// for longer than `max_unused_frames` are released.
+	class FrameBufferPool
+	{
+	public:
+		// How many frames a FrameBuffer can go unused before it is released
+		int max_unused_frames;
+
+		FrameBufferPool();
+		FrameBufferPool(int max_unused_frames);
+		FrameBufferPool(const FrameBufferPool&) = delete;
+		FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+		~FrameBufferPool();
+
+		// Gets a temporary FrameBuffer with a single RGBA Color attachment.
+		// The FrameBuffer is only valid until the next call to `frame` or `release`.
+		FrameBufferRef request(int width, int height);
+
+		// Gets a temporary FrameBuffer with the given Texture Attachments.
+		// The FrameBuffer is only valid until the next call to `frame` or `release`.
+		FrameBufferRef request(int width, int height, const TextureFormat* attachments, int attachment_count);
+
+		// Hands a FrameBuffer back to the pool before the end of the frame, so a later request can reuse it
+		void release(const FrameBufferRef& framebuffer);
+
+		// Hands every requested FrameBuffer back to the pool, and releases any that
+		// have gone unused for longer than `max_unused_frames`. Call this once per frame, after rendering.
+		void frame();
+
+		// Releases all the FrameBuffers in the pool
+		void clear();
+
+		// Gets the total number of FrameBuffers in the pool
+		int count() const;
+
+		// Gets the number of FrameBuffers that have been requested and not yet handed back
+		int in_use() const;
+
+		// Gets the estimated GPU memory, in bytes, of all the FrameBuffers in the pool
+		int64_t memory() const;
+
+		// Gets the estimated GPU memory, in bytes, of the FrameBuffers that are in use
+		int64_t memory_in_use() const;
+
+	private:
+		struct Entry
+		{
+			FrameBufferRef framebuffer;
+			StackVector<TextureFormat, BLAH_ATTACHMENTS> formats;
+			int64_t memory = 0;
+			uint64_t last_used = 0;
+			bool in_use = false;
+		};
+
+		Vector<Entry> m_entries;
+		uint64_t m_frame;
+	};
+}
@@ -65,8 +65,8 @@ namespace Blah
 		Mesh& operator=(const Mesh&) = delete;
 		Mesh& operator=(Mesh&&) = delete;
 
-		// Default Destructor
-		virtual ~Mesh() = default;
+		// Destructor
+		virtual ~Mesh();
 
 		// Creates a new Mesh.
 		// If the Mesh creation fails, it will return an invalid Mesh.
@@ -0,0 +1,89 @@
+#pragma once
+#include <inttypes.h>
+#include <functional>
+#include <blah/graphics/texture.h>
+#include <blah/core/filesystem.h>
+
+namespace Blah
+{
+	class Image;
+
+	// Keeps the GPU memory used by tracked Textures under a budget.
+	// Tracked Textures are stamped whenever they're drawn, and once the budget is exceeded
+	// the least recently used (non-pinned) Textures are evicted. Evicted Textures keep their
+	// TextureRef, and are reloaded from their source the next time they're drawn.
+	namespace Residency
+	{
+		// Fills the given Image with the source contents of an evicted Texture.
+		// Returns false if the Texture could not be reloaded.
+		using ReloadFn = std::function<bool(Image& image)>;
+
+		struct Stats
+		{
+			// The memory budget, in bytes (0 is unlimited)
+			int64_t budget = 0;
+
+			// Estimated memory of all tracked Textures, resident or not
+			int64_t tracked_bytes = 0;
+
+			// Estimated memory of the tracked Textures that are currently resident
+			int64_t resident_bytes = 0;
+
+			// Estimated memory of the pinned Textures
+			int64_t pinned_bytes = 0;
+
+			// Number of tracked Textures
+			int tracked = 0;
+
+			// Number of tracked Textures that are currently resident
+			int resident = 0;
+
+			// Number of pinned Textures
+			int pinned = 0;
+
+			// Number of Textures evicted during the last frame
+			int evicted_last_frame = 0;
+
+			// Number of Textures reloaded during the last frame
+			int reloaded_last_frame = 0;
+
+			// Total number of evictions since startup
+			int64_t evicted_total = 0;
+
+			// Total number of reloads since startup
+			int64_t reloaded_total = 0;
+		};
+
+		// Sets the GPU memory budget, in bytes, for all tracked Textures. 0 is unlimited.
+		void set_budget(int64_t bytes);
+
+		// Gets the GPU memory budget, in bytes
+		int64_t budget();
+
+		// Tracks a Texture, keeping a copy of the given Image to reload it from.
+		void track(const TextureRef& texture, const Image& source, bool pinned = false);
+
+		// Tracks a Texture, reloading it from the given image file.
+		void track(const TextureRef& texture, const FilePath& path, bool pinned = false);
+
+		// Tracks a Texture, reloading it with the given callback.
+		void track(const TextureRef& texture, const ReloadFn& reload, bool pinned = false);
+
+		// Stops tracking a Texture. If it was evicted it is not reloaded.
+		void untrack(const TextureRef& texture);
+
+		// Pins or unpins a tracked Texture. Pinned Textures are never evicted.
+		void pin(const TextureRef& texture, bool pinned = true);
+
+		// Marks a Texture as used this frame, and reloads it if it was evicted.
+		// This is called automatically by RenderPass::perform.
+		void touch(const Texture* texture);
+
+		// Evicts Textures until the budget is met.
+		// This is called automatically by the Application at the end of every frame.
+		void frame();
+
+		// Gets the current residency stats
+		Stats stats();
+	}
+}
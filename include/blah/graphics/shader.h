@@ -84,8 +84,8 @@ namespace Blah
 		Shader& operator=(const Shader&) = delete;
 		Shader& operator=(Shader&&) = delete;
 
-		// Default Destructor
-		virtual ~Shader() = default;
+		// Destructor
+		virtual ~Shader();
 
 		// Creates a Shader with the given Shader Data.
 		// If the Shader creation fails, it will return an invalid ShaderRef.
@@ -96,6 +96,13 @@ namespace Blah
 
 		// Gets a list of Shader Uniforms from Shader
 		virtual const Vector<UniformInfo>& uniforms() const = 0;
+
+		// Gets the data the Shader was created with
+		const ShaderData& data() const;
+
+	private:
+		ShaderData m_data;
+		StackVector<String, 16> m_semantic_names;
 	};
 
 }
\ No newline at end of file
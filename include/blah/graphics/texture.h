@@ -15,6 +15,7 @@ namespace Blah
 
 	class Image;
 	class Stream;
+	struct RectI;
 	class Texture;
 	typedef std::shared_ptr<Texture> TextureRef;
 
@@ -30,8 +31,8 @@ namespace Blah
 		Texture& operator=(const Texture&) = delete;
 		Texture& operator=(Texture&&) = delete;
 
-		// Default Destructor
-		virtual ~Texture() = default;
+		// Destructor
+		virtual ~Texture();
 
 		// Creates a new Texture.
 		// If the Texture creation fails, it will return an invalid TextureRef.
@@ -67,6 +68,11 @@ namespace Blah
 		// If the pixel buffer isn't the same size as the texture, it will set the minimum available amount of data.
 		virtual void set_data(unsigned char* data) = 0;
 
+		// Sets the data of a region of the Texture.
+		// Note that the pixel buffer should be in the same format as the Texture, and hold `rect.w * rect.h` pixels. There is no row padding.
+		// The region is clipped to the Texture's bounds.
+		virtual void set_data(const RectI& rect, unsigned char* data) = 0;
+
 		// Gets the data of the Texture.
 		// Note that the pixel buffer will be written to in the same format as the Texture,
 		// and you should allocate enough space for the full texture. There is no row padding.
@@ -74,5 +80,13 @@ namespace Blah
 
 		// Returns true if the Texture is part of a FrameBuffer
 		virtual bool is_framebuffer() const = 0;
+
+		// Releases the GPU memory used by the Texture, while keeping its size and format.
+		// The Texture has no contents until `set_data` is called again, which re-allocates it.
+		// FrameBuffer Textures can't be evicted.
+		virtual void evict() = 0;
+
+		// Returns true if the Texture currently has GPU memory allocated
+		virtual bool is_resident() const = 0;
 	};
 }
\ No newline at end of file
@@ -6,9 +6,11 @@
 
 namespace Blah
 {
+	class Packer;
+
 	// A simple Aseprite file parser.
-	// This implementation does not support Aseprite blendmodes,
-	// besides the default blend mode.
+	// Layers are composited with their blend modes, using ImageOps::blend.
+	// When loaded lazily, only the cels are kept and frames are composited on demand.
 	class Aseprite
 	{
 	public:
@@ -81,6 +83,9 @@ namespace Blah
 		struct Frame
 		{
 			int duration = 0;
+
+			// The composited frame. When loaded lazily this is empty unless
+			// the frame is in the cache, so prefer `frame_image`.
 			Image image;
 			Vector<Cel> cels;
 		};
@@ -129,17 +134,39 @@ namespace Blah
 		Vector<Slice> slices;
 		Vector<Color> palette;
 
+		// How many composited frames `frame_image` keeps when loaded lazily
+		int cache_size = 8;
+
 		Aseprite();
-		Aseprite(const char* path);
-		Aseprite(Stream& stream);
+		Aseprite(const char* path, bool lazy = false);
+		Aseprite(Stream& stream, bool lazy = false);
 		Aseprite(const Aseprite& src);
 		Aseprite(Aseprite&& src) noexcept;
 		Aseprite& operator=(const Aseprite& src);
 		Aseprite& operator=(Aseprite&& src) noexcept;
 		~Aseprite();
 
+		// Gets the composited image of a frame.
+		// When loaded lazily the frame is composited on first use, and the least recently used
+		// frames are released once more than `cache_size` are held.
+		const Image& frame_image(int index);
+
+		// Composites a frame into `pixels`, which must hold `width * height` colors
+		void render_frame(int index, Color* pixels) const;
+
+		// Composites a frame into a new Image
+		Image render_frame(int index) const;
+
+		// Composites a frame and adds it to the Packer, which keeps its own trimmed copy
+		void render_frame(int index, Packer& packer, uint64_t id) const;
+
+		// Returns true if frames are composited on demand
+		bool lazy() const;
+
 	private:
 		UserData* m_last_userdata = nullptr;
+		bool m_lazy = false;
+		Vector<int> m_cached;
 
 		void parse(Stream& stream);
 		void parse_layer(Stream& stream, int frame);
@@ -148,6 +175,6 @@ namespace Blah
 		void parse_user_data(Stream& stream, int frame);
 		void parse_tag(Stream& stream, int frame);
 		void parse_slice(Stream& stream, int frame);
-		void render_cel(Cel* cel, Frame* frame);
+		void render_cel(const Cel* cel, Color* pixels) const;
 	};
 }
\ No newline at end of file
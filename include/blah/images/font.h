@@ -2,6 +2,7 @@
 #include <blah/streams/stream.h>
 #include <blah/images/image.h>
 #include <blah/containers/str.h>
+#include <blah/containers/vector.h>
 
 namespace Blah
 {
@@ -22,6 +23,13 @@ namespace Blah
 			bool has_glyph = false;
 		};
 
+		struct Kerning
+		{
+			int glyph1 = 0;
+			int glyph2 = 0;
+			float value = 0;
+		};
+
 		Font();
 		Font(Stream& stream);
 		Font(const char* path);
@@ -44,8 +52,24 @@ namespace Blah
 		int get_glyph(Codepoint codepoint) const;
 		float get_scale(float size) const;
 		float get_kerning(int glyph1, int glyph2, float scale) const;
+
+		// Gets every non-zero kerning pair between the given glyphs, read straight out of the
+		// font's GPOS or kern table, so only pairs the font actually defines are visited.
+		// The values match what `get_kerning` returns for each pair.
+		Vector<Kerning> get_kernings(const Vector<int>& glyphs, float scale) const;
 		Char get_character(int glyph, float scale) const;
 		bool get_image(const Char& ch, Color* pixels) const;
+
+		// Gets the glyph's coverage, one byte per pixel
+		bool get_coverage(const Char& ch, uint8_t* pixels) const;
+
+		// Gets a signed distance field of the glyph, with `padding` pixels of room on each side,
+		// so `pixels` must hold (ch.width + padding * 2) * (ch.height + padding * 2) colors.
+		// RGB is white, and Alpha is 128 on the outline, moving by 128 / `padding` per pixel.
+		bool get_sdf_image(const Char& ch, int padding, Color* pixels) const;
+
+		// Gets a signed distance field of the glyph, as with `get_sdf_image`, but one byte per pixel
+		bool get_sdf_coverage(const Char& ch, int padding, uint8_t* pixels) const;
 		bool is_valid() const;
 
 	private:
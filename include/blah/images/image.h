@@ -2,11 +2,24 @@
 #include <blah/math/color.h>
 #include <blah/math/rectI.h>
 #include <blah/math/point.h>
+#include <blah/containers/vector.h>
 
 namespace Blah
 {
 	class Stream;
 
+	enum class ImageFilter
+	{
+		// Averages every source pixel under the destination pixel
+		Box,
+
+		// Blends between the nearest source pixels (a triangle filter when downscaling)
+		Bilinear,
+
+		// Windowed sinc with 3 lobes, the sharpest of the three
+		Lanczos3
+	};
+
 	class Image
 	{
 	public:
@@ -24,18 +37,31 @@ namespace Blah
 		Image& operator=(Image&& src) noexcept;
 		~Image();
 
+		// Loads a PNG, JPG, BMP or QOI image, detected from its contents
 		void from_stream(Stream& stream);
+		void from_memory(const void* data, int64_t length);
 		void dispose();
 
 		void premultiply();
 		void set_pixels(const RectI& rect, Color* data);
 		bool save_png(const char* file) const;
 		bool save_png(Stream& stream) const;
+		bool save_qoi(const char* file) const;
+		bool save_qoi(Stream& stream) const;
 		bool save_jpg(const char* file, int quality) const;
 		bool save_jpg(Stream& stream, int quality) const;
 		void get_pixels(Color* dest, const Point& destPos, const Point& destSize, RectI sourceRect);
 		Image get_sub_image(const RectI& sourceRect);
 
+		// Returns a copy of the Image scaled to the given size.
+		// Filtering is done with premultiplied alpha, so transparent pixels don't darken their neighbours.
+		Image resize(int width, int height, ImageFilter filter = ImageFilter::Bilinear) const;
+
+		// Returns every mip level below this one, down to 1x1, each averaging 2x2 blocks of the one above.
+		// Colors are weighted by their alpha unless the Image is already premultiplied.
+		// With `srgb`, colors are averaged in linear space and converted back.
+		Vector<Image> build_mips(bool srgb = false, bool premultiplied = false) const;
+
 	private:
 		bool m_stbi_ownership;
 	};
@@ -0,0 +1,55 @@
+#pragma once
+#include <blah/images/image.h>
+#include <blah/containers/vector.h>
+#include <blah/core/filesystem.h>
+#include <functional>
+#include <future>
+
+namespace Blah
+{
+	class Stream;
+
+	// Decodes images on a pool of worker threads.
+	// Each file is read into memory in full by the worker that decodes it.
+	class ImageLoader
+	{
+	public:
+		// Called on the worker thread once an image has been decoded.
+		// The image is empty if it couldn't be loaded. Images loaded from inside a callback
+		// are decoded right away on that worker, and callbacks must not call `wait`.
+		using Callback = std::function<void(const FilePath& path, Image& image)>;
+
+		// `threads` is the number of worker threads, or 0 for one per hardware thread.
+		// `max_in_flight` is the number of images that can be queued or decoding at once,
+		// or 0 for twice the number of threads. Queuing more than that blocks until one
+		// finishes, which bounds the memory used by encoded data waiting to be decoded.
+		ImageLoader(int threads = 0, int max_in_flight = 0);
+		ImageLoader(const ImageLoader&) = delete;
+		ImageLoader& operator=(const ImageLoader&) = delete;
+
+		// Waits for every queued image to finish
+		~ImageLoader();
+
+		// Queues a file to be decoded
+		std::future<Image> load(const FilePath& path);
+
+		// Queues a file to be decoded, and calls `on_loaded` on the worker thread when it's done
+		void load(const FilePath& path, const Callback& on_loaded);
+
+		// Reads the rest of the stream on the calling thread, and queues it to be decoded
+		std::future<Image> load(Stream& stream);
+
+		// Decodes every file, and returns the images in the same order
+		Vector<Image> load_all(const Vector<FilePath>& paths);
+
+		// Waits for every queued image to finish. Not allowed from inside a callback.
+		void wait();
+
+		// Gets the number of worker threads
+		int thread_count() const;
+
+	private:
+		struct Pool;
+		Pool* m_pool;
+	};
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <inttypes.h>
+#include <blah/math/color.h>
+#include <blah/math/rectI.h>
+
+namespace Blah
+{
+	// Vectorized pixel kernels used by Image, Aseprite and Packer.
+	// Each kernel uses SSE2 or NEON when available, and falls back to scalar code otherwise.
+	// The vectorized paths produce exactly the same results as the scalar ones.
+	namespace ImageOps
+	{
+		// Layer blend modes, in the same order as Aseprite stores them
+		enum class Blend
+		{
+			Normal,
+			Multiply,
+			Screen,
+			Overlay,
+			Darken,
+			Lighten,
+			ColorDodge,
+			ColorBurn,
+			HardLight,
+			SoftLight,
+			Difference,
+			Exclusion,
+			Hue,
+			Saturation,
+			Color,
+			Luminosity,
+			Addition,
+			Subtract,
+			Divide,
+			Count
+		};
+
+		// Multiplies the RGB channels by Alpha, as `c * a / 255`
+		void premultiply(Color* pixels, int64_t count);
+
+		// Divides the RGB channels by Alpha, as `(c * 255 + a / 2) / a`, clamped to 255.
+		// Pixels with an Alpha of 0 are left as-is.
+		void unpremultiply(Color* pixels, int64_t count);
+
+		// Swaps the Red and Blue channels, converting between RGBA and BGRA
+		void swizzle_rb(Color* pixels, int64_t count);
+
+		// Expands Grayscale+Alpha pairs into RGBA pixels.
+		// `src` and `dst` may point to the same memory, to expand in-place.
+		void gray_to_rgba(const uint8_t* src, Color* dst, int64_t count);
+
+		// Expands palette indices into RGBA pixels. Indices outside the palette become transparent.
+		// `src` and `dst` may point to the same memory, to expand in-place.
+		void indexed_to_rgba(const uint8_t* src, Color* dst, int64_t count, const Color* palette, int palette_count);
+
+		// Flips the pixels upside down
+		void flip_vertically(Color* pixels, int width, int height);
+
+		// Finds the smallest rectangle that contains every pixel with an Alpha above 0.
+		// Returns false if every pixel is transparent.
+		bool alpha_bounds(const Color* pixels, int width, int height, RectI* bounds);
+
+		// Draws the source pixels over the destination pixels with the given opacity,
+		// using non-premultiplied source-over blending (the same as Aseprite's "Normal" mode).
+		void blend_source_over(Color* dst, const Color* src, int64_t count, uint8_t opacity = 255);
+
+		// Draws the source pixels over the destination pixels with the given opacity and blend mode.
+		// Where the destination is transparent the source color is used as-is, and where it's opaque
+		// the blended color is, which is then drawn with source-over.
+		// The Hue, Saturation, Color and Luminosity modes are always scalar.
+		void blend(Color* dst, const Color* src, int64_t count, Blend mode, uint8_t opacity = 255);
+	}
+}
@@ -14,20 +14,47 @@ namespace Blah
 	class Packer
 	{
 	public:
+		enum class Algorithm
+		{
+			// Grows a binary tree of free space; pages are only as large as they need to be
+			Tree,
+
+			// Tracks every maximal free rectangle, and places each entry with the Best Short Side Fit
+			MaxRects,
+
+			// Tracks the top edge of the packed entries, and places each entry as low as possible
+			Skyline
+		};
+
 		class Entry
 		{
 		friend class Packer;
 		private:
-			int64_t memory_index;
+			// Where the trimmed source pixels are kept until they're copied into a page.
+			// Once copied they're freed, and read back out of the page if needed again.
+			const Color* source;
+			int source_stride;
+			int source_chunk;
+			bool source_rotated;
+			bool reserved;
 		public:
 			uint64_t id;
 			int page;
 			bool empty;
+			bool rotated;
 			RectI frame;
 			RectI packed;
 
 			Entry(uint64_t id, const RectI& frame)
-				: memory_index(0), id(id), page(0), empty(true), frame(frame), packed(0, 0, 0, 0) {}
+				: source(nullptr), source_stride(0), source_chunk(-1), source_rotated(false), reserved(false)
+				, id(id), page(0), empty(true), rotated(false), frame(frame), packed(0, 0, 0, 0) {}
+		};
+
+		// A region of a page that was changed by the last call to `pack`
+		struct Change
+		{
+			int page;
+			RectI rect;
 		};
 
 		int max_size;
@@ -35,9 +62,35 @@ namespace Blah
 		int spacing;
 		int padding;
 
+		// The packing algorithm to use
+		Algorithm algorithm;
+
+		// Whether entries may be rotated 90 degrees clockwise to fit better.
+		// Rotated entries have `rotated` set, and their `packed` rectangle is the rotated size on the page.
+		// Only used by the MaxRects and Skyline algorithms.
+		bool allow_rotation;
+
+		// When enabled, entries added since the last pack are placed into the free space
+		// of the existing pages (using MaxRects). Pages smaller than the max size grow to fit
+		// them if they have to, and any that still don't fit go onto new pages.
+		// Existing entries don't move, so only the changed regions need to be re-uploaded.
+		bool incremental;
+
+		// When packing incrementally, a full repack happens instead once the share of
+		// the pages covered by entries drops below this ratio
+		float repack_threshold;
+
+		// The packed pages. Source pixels are freed once they're copied into a page,
+		// so these have to be kept as-is for later calls to `pack` to work.
+		// Pages that only hold reserved entries have a size, but no pixels.
 		Vector<Image> pages;
 		Vector<Entry> entries;
 
+		// The regions of the pages that changed during the last call to `pack`.
+		// After a full repack, every page is listed in full, and may have changed size.
+		// Pages that grew while packing incrementally are also listed in full.
+		Vector<Change> changes;
+
 		Packer();
 		Packer(int max_size, int spacing, bool power_of_two);
 		Packer(const Packer&) = delete;
@@ -46,14 +99,41 @@ namespace Blah
 		Packer& operator=(Packer&& src) noexcept;
 		~Packer();
 		
-		void add(uint64_t id, int width, int height, const Color* pixels);
-		void add(uint64_t id, const Image& bitmap);
+		// Adds a source image. Its pixels are copied, unless `borrow` is true,
+		// in which case they must stay valid until the next call to `pack`.
+		void add(uint64_t id, int width, int height, const Color* pixels, bool borrow = false);
+		void add(uint64_t id, const Image& bitmap, bool borrow = false);
 		void add(uint64_t id, const String& path);
 
+		// Adds an entry that only reserves space, and isn't trimmed. Nothing is copied into
+		// the pages for it, so callers can fill pages of their own format (ex. single-channel).
+		void add(uint64_t id, int width, int height);
+
 		void pack();
 		void clear();
 		void dispose();
 
+		// Returns true if the trimmed pixels of the entry at `index` are the same as
+		// the `bounds` of the given pixels, which are `stride` pixels wide
+		bool same_pixels(int index, const Color* pixels, int stride, const RectI& bounds) const;
+
+		// Gets the ratio of the page's area that is covered by packed entries
+		float occupancy(int page) const;
+
+		// Gets a hash of the packer settings and every entry added so far, including their pixels.
+		// Useful as the key of a cache, when the source images have to be loaded anyway.
+		uint64_t hash() const;
+
+		// Writes the packed pages and entries to the stream, tagged with the given key.
+		// Packs first, if anything has changed.
+		bool save_cache(Stream& stream, uint64_t key);
+
+		// Replaces the pages and entries with the ones in the cache, if it was saved
+		// with the same key and packer settings. Returns false otherwise, leaving the Packer as-is.
+		// The key can be anything that identifies the inputs, such as a hash of file names
+		// and modified times, in which case the source images never need to be loaded.
+		bool load_cache(Stream& stream, uint64_t key);
+
 	private:
 		struct Node
 		{
@@ -67,9 +147,30 @@ namespace Blah
 			Node* Reset(const RectI& rect);
 		};
 
+		// A block of source pixels, freed once everything in it has been copied into a page
+		struct Chunk
+		{
+			Color* pixels;
+			int64_t capacity;
+			int64_t used;
+			int references;
+		};
+
 		bool m_dirty;
-		BufferStream m_buffer;
+		Vector<Chunk> m_chunks;
+
+		// incremental packing state
+		int m_packed_count;
+		uint64_t m_packed_settings;
+		Vector<Vector<RectI>> m_free;
 
-		void add_entry(uint64_t id, int w, int h, const Color* pixels);
+		void add_entry(uint64_t id, int w, int h, const Color* pixels, bool borrow);
+		void free_chunks();
+		bool pack_incremental();
+		void compose(const Vector<Entry*>& list);
+		bool source_pixels(const Entry& entry, const Color** pixels, int* stride, bool* rotated) const;
+		uint64_t calc_settings() const;
+		void pack_tree(Vector<Entry*>& sources, Vector<Point>& page_sizes);
+		bool pack_rects(Vector<Entry*>& sources, Vector<Point>& page_sizes);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include <blah/streams/stream.h>
+
+namespace Blah
+{
+	// Decompresses zlib or raw deflate data from another Stream as it's read.
+	// Compressed data is pulled from the source in small chunks, and decompressed
+	// straight into the buffer given to `read`, so nothing is staged in memory
+	// besides the 32KB window deflate requires.
+	class InflateStream : public Stream
+	{
+	public:
+		// Reads up to `compressed_length` bytes from the source, or the rest of it if negative.
+		// The source's position is undefined once reading has started.
+		InflateStream(Stream& source, int64_t compressed_length = -1, bool zlib = true);
+		InflateStream(InflateStream&& src) noexcept;
+		InflateStream& operator=(InflateStream&& src) noexcept;
+		~InflateStream();
+
+		// The decompressed length isn't known up front, so this is the number
+		// of bytes decompressed so far until the end of the data is reached
+		virtual int64_t length() const override;
+		virtual int64_t position() const override;
+
+		// Only seeking forward is supported, which decompresses and discards the data in between
+		virtual int64_t seek(int64_t seek_to) override;
+		virtual bool is_open() const override;
+		virtual bool is_readable() const override { return true; }
+		virtual bool is_writable() const override { return false; }
+		virtual void close() override;
+
+		// Returns true once the end of the compressed data has been reached
+		bool is_finished() const;
+
+		// Returns true if the compressed data was invalid or ended early
+		bool has_error() const;
+
+	protected:
+		virtual int64_t read_into(void* ptr, int64_t length) override;
+		virtual int64_t write_from(const void* ptr, int64_t length) override;
+
+	private:
+		struct State;
+		State* m_state;
+	};
+}
@@ -3,9 +3,11 @@
 #include <blah/core/time.h>
 #include <blah/math/point.h>
 #include <blah/graphics/framebuffer.h>
+#include <blah/graphics/residency.h>
 #include "../internal/platform_backend.h"
 #include "../internal/graphics_backend.h"
 #include "../internal/input_backend.h"
+#include "../internal/capture.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -107,6 +109,8 @@ namespace
 				app_config.on_render();
 
 			GraphicsBackend::after_render();
+			Residency::frame();
+			Capture::on_frame();
 			PlatformBackend::present();
 		}
 	}
@@ -302,6 +306,7 @@ namespace
 
 		virtual void clear(Color color, float depth, uint8_t stencil, ClearMask mask) override
 		{
+			Capture::on_clear(this, color, depth, stencil, mask);
 			GraphicsBackend::clear_backbuffer(color, depth, stencil, mask);
 		}
 	};
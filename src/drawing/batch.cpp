@@ -55,10 +55,12 @@ namespace
 		"void main(void)\n"
 		"{\n"
 		"	vec4 color = texture(u_texture, v_tex);\n"
+		"	float edge = max(fwidth(color.a) * 0.5, 0.001);\n"
 		"	o_color = \n"
 		"		v_type.x * color * v_col + \n"
 		"		v_type.y * color.a * v_col + \n"
-		"		v_type.z * v_col;\n"
+		"		v_type.z * v_col + \n"
+		"		v_type.w * smoothstep(0.5 - edge, 0.5 + edge, color.a) * v_col;\n"
 		"}"
 	};
 
@@ -104,10 +106,12 @@ namespace
 		"float4 ps_main(vs_out input) : SV_TARGET\n"
 		"{\n"
 		"	float4 color = u_texture.Sample(u_sampler, input.texcoord);\n"
+		"	float edge = max(fwidth(color.a) * 0.5f, 0.001f);\n"
 		"	return\n"
 		"		input.mask.x * color * input.color + \n"
 		"		input.mask.y * color.a * input.color + \n"
-		"		input.mask.z * input.color;\n"
+		"		input.mask.z * input.color + \n"
+		"		input.mask.w * smoothstep(0.5f - edge, 0.5f + edge, color.a) * input.color;\n"
 		"}\n";
 
 	const ShaderData shader_data = {
@@ -158,7 +162,8 @@ namespace
 	(vert)->col = c; \
 	(vert)->mult = m; \
 	(vert)->wash = w; \
-	(vert)->fill = f;
+	(vert)->fill = f; \
+	(vert)->sdf = m_tex_sdf;
 	
 #define PUSH_QUAD(px0, py0, px1, py1, px2, py2, px3, py3, tx0, ty0, tx1, ty1, tx2, ty2, tx3, ty3, col0, col1, col2, col3, mult, fill, wash) \
 	{ \
@@ -435,6 +440,7 @@ void Batch::clear()
 	m_color_mode = ColorMode::Normal;
 	m_tex_mult = 255;
 	m_tex_wash = 0;
+	m_tex_sdf = 0;
 
 	m_vertices.clear();
 	m_indices.clear();
@@ -1030,6 +1036,19 @@ void Batch::str(const SpriteFont& font, const String& text, const Vec2& pos, Tex
 		Mat3x2::create_translation(pos)
 	);
 
+	// distance field glyphs are drawn with their own shader path, and need linear filtering
+	auto mult = m_tex_mult;
+	auto wash = m_tex_wash;
+	auto sampler = m_batch.sampler;
+
+	if (font.sdf_padding > 0)
+	{
+		m_tex_mult = 0;
+		m_tex_wash = 0;
+		m_tex_sdf = 255;
+		set_sampler(TextureSampler(TextureFilter::Linear, TextureWrap::Clamp, TextureWrap::Clamp));
+	}
+
 	Vec2 offset;
 
 	if ((align & TextAlign::Left) == TextAlign::Left)
@@ -1092,5 +1111,13 @@ void Batch::str(const SpriteFont& font, const String& text, const Vec2& pos, Tex
 		last = next;
 	}
 
+	if (font.sdf_padding > 0)
+	{
+		m_tex_mult = mult;
+		m_tex_wash = wash;
+		m_tex_sdf = 0;
+		set_sampler(sampler);
+	}
+
 	pop_matrix();
 }
\ No newline at end of file
@@ -1,16 +1,372 @@
 #include <blah/drawing/spritefont.h>
 #include <blah/images/font.h>
 #include <blah/images/packer.h>
+#include <blah/core/app.h>
 #include <blah/core/log.h>
+#include <blah/core/time.h>
+#include <blah/streams/filestream.h>
+#include <blah/streams/memorystream.h>
+#include <blah/streams/bufferstream.h>
+#include <blah/streams/inflatestream.h>
+#include "../internal/parallel.h"
+#include "../internal/png.h"
+#include <algorithm>
 
 using namespace Blah;
 
+namespace
+{
+	// codepoints below this are found directly by index (Latin, Greek, Cyrillic, Hebrew, Arabic, ...)
+	constexpr uint32_t direct_count = 0x800;
+
+	constexpr char file_magic[8] = { 'B', 'L', 'A', 'H', 'F', 'O', 'N', 'T' };
+	constexpr uint32_t file_version = 1;
+
+	uint32_t hash_codepoint(uint32_t codepoint)
+	{
+		uint32_t hash = codepoint * 0x9E3779B1u;
+		return hash ^ (hash >> 16);
+	}
+
+	// atlases are single-channel when the renderer samples R textures as (r, r, r, r), so
+	// they draw the same as RGBA ones with any Shader, and are RGBA otherwise
+	TextureFormat atlas_format()
+	{
+		return (App::renderer_features().red_swizzle ? TextureFormat::R : TextureFormat::RGBA);
+	}
+
+	// uploads one byte of coverage per pixel to the texture, expanded to the same colors
+	// Font::get_image and Font::get_sdf_image produce if it's RGBA
+	void set_coverage(const TextureRef& texture, const RectI& rect, uint8_t* coverage, bool sdf, Vector<Color>& colors)
+	{
+		if (texture->format() == TextureFormat::R)
+		{
+			texture->set_data(rect, coverage);
+			return;
+		}
+
+		colors.resize(rect.w * rect.h);
+		for (int i = 0; i < colors.size(); i++)
+			colors[i] = (sdf ? Color(255, 255, 255, coverage[i]) : Color(coverage[i], coverage[i], coverage[i], coverage[i]));
+		texture->set_data(rect, (unsigned char*)colors.data());
+	}
+}
+
+struct SpriteFont::Dynamic
+{
+	struct Glyph
+	{
+		// font glyph index, 0 if the font doesn't have the character, or -1 if it hasn't been looked up
+		int glyph = -1;
+		Font::Char ch;
+
+		// where the glyph is cached, if it is
+		int page = -1;
+		int shelf = 0;
+		RectI slot;
+
+		// neighbours in the list of cached glyphs, most recently used first
+		int prev = -1;
+		int next = -1;
+		uint64_t frame = 0;
+	};
+
+	// a row of glyphs of similar height
+	struct Shelf
+	{
+		int y = 0;
+		int height = 0;
+		int x = 0;
+		int count = 0;
+		Vector<RectI> free;
+	};
+
+	struct Page
+	{
+		TextureRef texture;
+		Vector<Shelf> shelves;
+		int bottom = 0;
+	};
+
+	Font font;
+	float scale = 0;
+	int page_size = 0;
+	int max_pages = 0;
+	int newest = -1;
+	int oldest = -1;
+	bool warned = false;
+	// indexed the same as the SpriteFont's characters
+	Vector<Glyph> glyphs;
+	Vector<Page> pages;
+	Vector<uint8_t> buffer;
+	Vector<Color> colors;
+
+	Glyph& lookup(int index, const SpriteFont& owner);
+	void rasterize(int index, const SpriteFont& owner);
+	bool allocate(Glyph& glyph, int width, int height, Vector<TextureRef>& atlas);
+	bool evict(const SpriteFont& owner);
+	void release(int index, const SpriteFont& owner);
+	void touch(int index);
+	void unlink(int index);
+};
+
+SpriteFont::Dynamic::Glyph& SpriteFont::Dynamic::lookup(int index, const SpriteFont& owner)
+{
+	if (glyphs.size() <= index)
+		glyphs.resize(owner.m_characters.size());
+
+	auto& glyph = glyphs[index];
+	if (glyph.glyph >= 0)
+		return glyph;
+
+	// metrics are stored the first time a character is requested, the image only once it's drawn
+	auto& entry = owner.m_characters[index];
+	glyph.glyph = font.get_glyph(entry.codepoint);
+
+	if (glyph.glyph > 0)
+	{
+		int sdf_padding = owner.sdf_padding;
+
+		glyph.ch = font.get_character(glyph.glyph, scale);
+		entry.character.advance = glyph.ch.advance;
+		entry.character.offset = Vec2(glyph.ch.offset_x, glyph.ch.offset_y);
+
+		if (glyph.ch.has_glyph && sdf_padding > 0)
+			entry.character.offset -= Vec2((float)sdf_padding, (float)sdf_padding);
+	}
+
+	return glyph;
+}
+
+void SpriteFont::Dynamic::rasterize(int index, const SpriteFont& owner)
+{
+	auto& glyph = glyphs[index];
+	int sdf_padding = owner.sdf_padding;
+
+	// the glyph is surrounded by a transparent border, so filtering never picks up its neighbours
+	int width = glyph.ch.width + sdf_padding * 2;
+	int height = glyph.ch.height + sdf_padding * 2;
+	int slot_width = width + 2;
+	int slot_height = height + 2;
+
+	if (slot_width > page_size || slot_height > page_size)
+	{
+		Log::warn("Glyph of %ix%i doesn't fit in the SpriteFont's %ix%i pages", width, height, page_size, page_size);
+		glyph.ch.has_glyph = false;
+		return;
+	}
+
+	buffer.resize(slot_width * slot_height + width * height);
+	uint8_t* slot = buffer.data();
+	uint8_t* image = buffer.data() + slot_width * slot_height;
+
+	bool rendered = (sdf_padding > 0 ?
+		font.get_sdf_coverage(glyph.ch, sdf_padding, image) :
+		font.get_coverage(glyph.ch, image));
+
+	if (!rendered)
+	{
+		glyph.ch.has_glyph = false;
+		return;
+	}
+
+	memset(slot, 0, slot_width * slot_height);
+	for (int y = 0; y < height; y++)
+		memcpy(slot + (y + 1) * slot_width + 1, image + y * width, width);
+
+	// evict the least recently used glyphs until there's room
+	while (!allocate(glyph, slot_width, slot_height, owner.m_atlas))
+	{
+		if (!evict(owner))
+			return;
+	}
+
+	touch(index);
+
+	auto& texture = pages[glyph.page].texture;
+	set_coverage(texture, RectI(glyph.slot.x, glyph.slot.y, slot_width, slot_height), slot, sdf_padding > 0, colors);
+	owner.m_characters[index].character.subtexture = Subtexture(texture, Rect((float)glyph.slot.x + 1, (float)glyph.slot.y + 1, (float)width, (float)height));
+}
+
+bool SpriteFont::Dynamic::allocate(Glyph& glyph, int width, int height, Vector<TextureRef>& atlas)
+{
+	// shelf heights are rounded up, so glyphs of similar sizes share them
+	int shelf_height = (height + 3) & ~3;
+	if (shelf_height > page_size)
+		shelf_height = page_size;
+
+	auto take = [&](int page, int shelf, const RectI& slot)
+	{
+		pages[page].shelves[shelf].count++;
+		glyph.page = page;
+		glyph.shelf = shelf;
+		glyph.slot = slot;
+	};
+
+	for (int p = 0; p <= pages.size(); p++)
+	{
+		if (p == pages.size())
+		{
+			if (pages.size() >= max_pages)
+				return false;
+
+			auto format = atlas_format();
+			auto texture = Texture::create(page_size, page_size, format);
+			if (!texture)
+				return false;
+
+			Vector<uint8_t> clear;
+			clear.resize(page_size * page_size * (format == TextureFormat::R ? 1 : 4));
+			texture->set_data(clear.data());
+
+			Page page;
+			page.texture = texture;
+			pages.push_back(page);
+			atlas.push_back(texture);
+		}
+
+		auto& page = pages[p];
+
+		for (int s = 0; s < page.shelves.size(); s++)
+		{
+			auto& shelf = page.shelves[s];
+
+			// empty shelves can be taken over by any glyph that fits
+			if (shelf.height != shelf_height && (shelf.count > 0 || shelf.height < height))
+				continue;
+
+			// reuse the space of an evicted glyph
+			for (int i = 0; i < shelf.free.size(); i++)
+			{
+				auto& space = shelf.free[i];
+				if (space.w < width)
+					continue;
+
+				RectI slot(space.x, space.y, width, shelf.height);
+				space.x += width;
+				space.w -= width;
+				if (space.w <= 0)
+					shelf.free.erase(i);
+
+				take(p, s, slot);
+				return true;
+			}
+
+			if (shelf.x + width <= page_size)
+			{
+				take(p, s, RectI(shelf.x, shelf.y, width, shelf.height));
+				shelf.x += width;
+				return true;
+			}
+		}
+
+		if (page.bottom + shelf_height <= page_size)
+		{
+			Shelf shelf;
+			shelf.y = page.bottom;
+			shelf.height = shelf_height;
+			shelf.x = width;
+			page.bottom += shelf_height;
+			page.shelves.push_back(shelf);
+
+			take(p, page.shelves.size() - 1, RectI(0, shelf.y, width, shelf_height));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SpriteFont::Dynamic::evict(const SpriteFont& owner)
+{
+	if (oldest < 0)
+		return false;
+
+	// glyphs drawn this frame may still be waiting in a Batch, and as the list is kept in order
+	// of use, the oldest one only belongs to this frame once every cached glyph does
+	if (glyphs[oldest].frame == Time::ticks && !warned)
+	{
+		Log::warn("SpriteFont glyph cache is too small for a single frame, increase its page size or count");
+		warned = true;
+	}
+
+	release(oldest, owner);
+	return true;
+}
+
+void SpriteFont::Dynamic::release(int index, const SpriteFont& owner)
+{
+	unlink(index);
+
+	auto& glyph = glyphs[index];
+	auto& page = pages[glyph.page];
+	auto& shelf = page.shelves[glyph.shelf];
+
+	shelf.count--;
+	if (shelf.count > 0)
+	{
+		shelf.free.push_back(glyph.slot);
+	}
+	else
+	{
+		shelf.x = 0;
+		shelf.free.clear();
+
+		// give empty shelves at the bottom of the page back to it
+		while (page.shelves.size() > 0 && page.shelves.back().count <= 0)
+		{
+			page.bottom = page.shelves.back().y;
+			page.shelves.pop();
+		}
+	}
+
+	// the metrics are kept, so only the image is lost
+	owner.m_characters[index].character.subtexture = Subtexture();
+	glyph.page = -1;
+}
+
+void SpriteFont::Dynamic::touch(int index)
+{
+	unlink(index);
+
+	auto& glyph = glyphs[index];
+	glyph.next = newest;
+	if (newest >= 0)
+		glyphs[newest].prev = index;
+	else
+		oldest = index;
+	newest = index;
+}
+
+void SpriteFont::Dynamic::unlink(int index)
+{
+	auto& glyph = glyphs[index];
+
+	// glyphs that aren't cached aren't in the list
+	if (glyph.prev < 0 && newest != index)
+		return;
+
+	if (glyph.prev >= 0)
+		glyphs[glyph.prev].next = glyph.next;
+	else
+		newest = glyph.next;
+
+	if (glyph.next >= 0)
+		glyphs[glyph.next].prev = glyph.prev;
+	else
+		oldest = glyph.prev;
+
+	glyph.prev = -1;
+	glyph.next = -1;
+}
+
 SpriteFont::SpriteFont()
 {
 	size = 0;
 	ascent = 0;
 	descent = 0;
 	line_gap = 0;
+	sdf_padding = 0;
 }
 
 const uint32_t ascii[]{ 32, 128, 0 };
@@ -43,9 +399,14 @@ SpriteFont::SpriteFont(SpriteFont&& src) noexcept
 	ascent = src.ascent;
 	descent = src.descent;
 	line_gap = src.line_gap;
+	sdf_padding = src.sdf_padding;
 	m_characters = std::move(src.m_characters);
+	m_direct = std::move(src.m_direct);
+	m_table = std::move(src.m_table);
 	m_kerning = std::move(src.m_kerning);
 	m_atlas = std::move(src.m_atlas);
+	m_dynamic = src.m_dynamic;
+	src.m_dynamic = nullptr;
 }
 
 SpriteFont::~SpriteFont()
@@ -57,8 +418,13 @@ void SpriteFont::dispose()
 {
 	m_atlas.clear();
 	m_characters.clear();
+	m_direct.clear();
+	m_table.clear();
 	m_kerning.clear();
 	name.dispose();
+
+	delete m_dynamic;
+	m_dynamic = nullptr;
 }
 
 SpriteFont& SpriteFont::operator=(SpriteFont && src) noexcept
@@ -68,9 +434,15 @@ SpriteFont& SpriteFont::operator=(SpriteFont && src) noexcept
 	ascent = src.ascent;
 	descent = src.descent;
 	line_gap = src.line_gap;
+	sdf_padding = src.sdf_padding;
 	m_characters = std::move(src.m_characters);
+	m_direct = std::move(src.m_direct);
+	m_table = std::move(src.m_table);
 	m_kerning = std::move(src.m_kerning);
 	m_atlas = std::move(src.m_atlas);
+	delete m_dynamic;
+	m_dynamic = src.m_dynamic;
+	src.m_dynamic = nullptr;
 	return *this;
 }
 
@@ -92,7 +464,7 @@ float SpriteFont::width_of(const String& text) const
 		auto next = text.utf8_at(i);
 
 		// increment length
-		line_width += this->operator[](next).advance;
+		line_width += find(next, false).advance;
 		
 		// add kerning
 		if (i > 0)
@@ -126,7 +498,7 @@ float SpriteFont::width_of_line(const String& text, int start) const
 		auto next = text.utf8_at(i);
 
 		// increment length
-		width += this->operator[](next).advance;
+		width += find(next, false).advance;
 		
 		// add kerning
 		if (i > 0)
@@ -167,6 +539,99 @@ void SpriteFont::build(const char* file, float sz, const uint32_t* charset)
 }
 
 void SpriteFont::build(const Font& font, float size, const uint32_t* charset)
+{
+	build_atlas(font, size, charset, 0);
+}
+
+void SpriteFont::build_sdf(const char* file, float sz, const uint32_t* charset, int padding)
+{
+	dispose();
+
+	Font font(file);
+	if (font.is_valid())
+		build_sdf(font, sz, charset, padding);
+}
+
+void SpriteFont::build_sdf(const Font& font, float size, const uint32_t* charset, int padding)
+{
+	BLAH_ASSERT(padding > 0, "SDF padding must be larger than 0");
+	build_atlas(font, size, charset, padding);
+}
+
+void SpriteFont::build_atlas(const Font& font, float size, const uint32_t* charset, int sdf_padding)
+{
+	BuildInfo info;
+	info.font = this;
+	info.source = &font;
+	info.size = size;
+	info.charset = charset;
+	info.sdf_padding = sdf_padding;
+	build_all(&info, 1);
+}
+
+struct SpriteFont::Atlas
+{
+	struct Glyph
+	{
+		uint32_t codepoint;
+		Font::Char ch;
+		int64_t offset;
+		int width;
+		int height;
+		bool rendered;
+	};
+
+	const Font* font;
+	float scale;
+	int sdf_padding;
+
+	// every glyph is rasterized into its own range of the buffer, one byte per pixel,
+	// so they can all be made at once without sharing any scratch memory
+	Vector<Glyph> glyphs;
+	Vector<uint8_t> buffer;
+
+	std::unordered_map<uint32_t, int> font_glyphs;
+	Packer packer;
+	Vector<Vector<uint8_t>> pages;
+};
+
+void SpriteFont::build_all(const BuildInfo* fonts, int count)
+{
+	Vector<Atlas> atlases;
+	atlases.resize(count);
+
+	for (int i = 0; i < count; i++)
+		fonts[i].font->begin_atlas(atlases[i], *fonts[i].source, fonts[i].size, fonts[i].charset, fonts[i].sdf_padding);
+
+	// rasterize the glyphs of every font together, across the worker threads
+	Vector<int> first;
+	int total = 0;
+	for (auto& it : atlases)
+	{
+		first.push_back(total);
+		total += it.glyphs.size();
+	}
+
+	Parallel::for_each(total, [&](int index)
+	{
+		int a = (int)(std::upper_bound(first.begin(), first.end(), index) - first.begin()) - 1;
+		auto& atlas = atlases[a];
+		auto& it = atlas.glyphs[index - first[a]];
+		auto pixels = atlas.buffer.data() + it.offset;
+
+		it.rendered = (atlas.sdf_padding > 0 ?
+			atlas.font->get_sdf_coverage(it.ch, atlas.sdf_padding, pixels) :
+			atlas.font->get_coverage(it.ch, pixels));
+	});
+
+	// each font is packed on its own, and textures are only created on this thread
+	Parallel::for_each(count, [&](int i) { fonts[i].font->pack_atlas(atlases[i]); });
+
+	for (int i = 0; i < count; i++)
+		fonts[i].font->end_atlas(atlases[i]);
+}
+
+void SpriteFont::begin_atlas(Atlas& atlas, const Font& font, float size, const uint32_t* charset, int sdf_padding)
 {
 	dispose();
 
@@ -177,16 +642,13 @@ void SpriteFont::build(const Font& font, float size, const uint32_t* charset)
 	descent = font.descent() * scale;
 	line_gap = font.line_gap() * scale;
 	this->size = size;
+	this->sdf_padding = sdf_padding;
 
-	Packer packer;
-	packer.spacing = 0;
-	packer.padding = 1;
-	packer.max_size = 8192;
-	packer.power_of_two = true;
-	
-	std::unordered_map<uint32_t, int> glyphs;
-	Vector<Color> buffer;
+	atlas.font = &font;
+	atlas.scale = scale;
+	atlas.sdf_padding = sdf_padding;
 
+	int64_t total = 0;
 	auto ranges = charset;
 	while (*ranges != 0)
 	{
@@ -201,86 +663,626 @@ void SpriteFont::build(const Font& font, float size, const uint32_t* charset)
 			if (glyph <= 0)
 				continue;
 
-			glyphs[i] = glyph;
+			atlas.font_glyphs[i] = glyph;
 
 			// add character
 			Font::Char ch = font.get_character(glyph, scale);
-			m_characters[i].advance = ch.advance;
-			m_characters[i].offset = Vec2(ch.offset_x, ch.offset_y);
+			auto& character = m_characters[insert(i)].character;
+			character.advance = ch.advance;
+			character.offset = Vec2(ch.offset_x, ch.offset_y);
 
-			// pack glyph
+			// queue up the glyph, in charset order so the pack is the same every time
 			if (ch.has_glyph)
 			{
-				if (buffer.size() < ch.width * ch.height)
-					buffer.resize(ch.width * ch.height);
+				if (sdf_padding > 0)
+					character.offset -= Vec2((float)sdf_padding, (float)sdf_padding);
 
-				if (font.get_image(ch, buffer.data()))
-					packer.add(i, ch.width, ch.height, buffer.data());
+				Atlas::Glyph image;
+				image.codepoint = i;
+				image.ch = ch;
+				image.offset = total;
+				image.width = ch.width + sdf_padding * 2;
+				image.height = ch.height + sdf_padding * 2;
+				image.rendered = false;
+				atlas.glyphs.push_back(image);
+				total += (int64_t)image.width * image.height;
 			}
 		}
 
 		ranges += 2;
 	}
 
-	buffer.clear();
+	atlas.buffer.resize((int)total);
+}
+
+void SpriteFont::pack_atlas(Atlas& atlas)
+{
+	auto& packer = atlas.packer;
+	packer.spacing = 0;
+	packer.padding = 1;
+	packer.max_size = 8192;
+	packer.power_of_two = true;
+
+	// the packer only lays the glyphs out, and they're copied into the pages here
+	Vector<int> packed;
+	for (int i = 0; i < atlas.glyphs.size(); i++)
+	{
+		auto& it = atlas.glyphs[i];
+		if (!it.rendered)
+			continue;
+
+		packer.add(it.codepoint, it.width, it.height);
+		packed.push_back(i);
+	}
+
 	packer.pack();
 
-	for (auto& it : packer.pages)
-		m_atlas.push_back(Texture::create(it));
+	atlas.pages.resize(packer.pages.size());
+	for (int i = 0; i < atlas.pages.size(); i++)
+		atlas.pages[i].resize(packer.pages[i].width * packer.pages[i].height);
+
+	for (int i = 0; i < packer.entries.size(); i++)
+	{
+		auto& entry = packer.entries[i];
+		if (entry.empty)
+			continue;
+
+		auto& image = atlas.glyphs[packed[i]];
+		auto& page = atlas.pages[entry.page];
+		int width = packer.pages[entry.page].width;
+
+		for (int y = 0; y < image.height; y++)
+			memcpy(page.data() + entry.packed.x + (int64_t)(entry.packed.y + y) * width, atlas.buffer.data() + image.offset + (int64_t)y * image.width, image.width);
+	}
+
+	atlas.buffer.clear();
+
+	// add kerning, from the pairs the font actually defines
+	std::unordered_map<int, Vector<uint32_t>> codepoints;
+	Vector<int> glyph_list;
+	for (auto& it : atlas.font_glyphs)
+	{
+		auto& list = codepoints[it.second];
+		if (list.size() <= 0)
+			glyph_list.push_back(it.second);
+		list.push_back(it.first);
+	}
+
+	for (auto& it : atlas.font->get_kernings(glyph_list, atlas.scale))
+	{
+		for (auto a : codepoints[it.glyph1])
+			for (auto b : codepoints[it.glyph2])
+			{
+				Kerning kerning;
+				kerning.pair = ((uint64_t)a << 32) | b;
+				kerning.value = it.value;
+				m_kerning.push_back(kerning);
+			}
+	}
+
+	std::sort(m_kerning.begin(), m_kerning.end(), [](const Kerning& a, const Kerning& b) { return a.pair < b.pair; });
+
+	for (auto& it : m_kerning)
+		m_characters[find_index((uint32_t)(it.pair >> 32))].kerning = true;
+}
+
+void SpriteFont::end_atlas(Atlas& atlas)
+{
+	auto& packer = atlas.packer;
+	auto format = atlas_format();
+	Vector<Color> colors;
+
+	for (int i = 0; i < atlas.pages.size(); i++)
+	{
+		int width = packer.pages[i].width;
+		int height = packer.pages[i].height;
+		auto texture = Texture::create(width, height, format);
+		if (texture)
+			set_coverage(texture, RectI(0, 0, width, height), atlas.pages[i].data(), atlas.sdf_padding > 0, colors);
+		m_atlas.push_back(texture);
+	}
 
 	// add character subtextures
 	for (auto& it : packer.entries)
 		if (!it.empty)
-			m_characters[(uint32_t)it.id].subtexture = Subtexture(m_atlas[it.page], it.packed, it.frame);
+			m_characters[find_index((uint32_t)it.id)].character.subtexture = Subtexture(m_atlas[it.page], it.packed, it.frame);
+}
+
+bool SpriteFont::save(const char* file, bool compressed) const
+{
+	FileStream fs(file, FileMode::Write);
+	return fs.is_writable() && save(fs, compressed);
+}
+
+bool SpriteFont::save(Stream& stream, bool compressed) const
+{
+	if (!stream.is_writable())
+		return false;
+
+	if (m_dynamic)
+	{
+		Log::warn("Dynamic SpriteFonts can't be saved, as their atlas changes as they're used");
+		return false;
+	}
+
+	// header
+	int64_t expected = 0;
+	int64_t written = stream.write(file_magic, sizeof(file_magic));
+	written += stream.write<uint32_t>(file_version);
+	written += stream.write<int32_t>(name.length());
+	written += stream.write(name);
+	written += stream.write<float>(size);
+	written += stream.write<float>(ascent);
+	written += stream.write<float>(descent);
+	written += stream.write<float>(line_gap);
+	written += stream.write<int32_t>(sdf_padding);
+	written += stream.write<uint32_t>(m_atlas.size());
+	expected += sizeof(file_magic) + 4 + 4 + name.length() + 4 * 5 + 4;
+
+	// atlas pages
+	Vector<uint8_t> pixels;
+	BufferStream deflated;
+
+	for (auto& it : m_atlas)
+	{
+		if (!it || (it->format() != TextureFormat::R && it->format() != TextureFormat::RGBA))
+		{
+			Log::warn("SpriteFont atlas must be an R or RGBA texture to be saved");
+			return false;
+		}
+
+		int width = it->width();
+		int height = it->height();
+		int channels = (it->format() == TextureFormat::R ? 1 : 4);
+
+		pixels.resize(width * height * channels);
+		it->get_data(pixels.data());
+
+		const void* data = pixels.data();
+		int64_t length = pixels.size();
+
+		if (compressed)
+		{
+			deflated.clear();
+			if (!Png::compress(deflated, data, length))
+				return false;
+			data = deflated.data();
+			length = deflated.length();
+		}
+
+		written += stream.write<int32_t>(width);
+		written += stream.write<int32_t>(height);
+		written += stream.write<uint8_t>(channels);
+		written += stream.write<uint8_t>(compressed ? 1 : 0);
+		written += stream.write<int64_t>(length);
+		written += stream.write(data, length);
+		expected += 4 + 4 + 1 + 1 + 8 + length;
+	}
+
+	// characters
+	written += stream.write<uint32_t>(m_characters.size());
+	expected += 4;
+
+	for (auto& it : m_characters)
+	{
+		auto& subtexture = it.character.subtexture;
 
-	// add kerning
-	for (auto a = glyphs.begin(); a != glyphs.end(); a++)
-		for (auto b = glyphs.begin(); b != glyphs.end(); b++)
+		int page = -1;
+		for (int i = 0; i < m_atlas.size() && subtexture.texture; i++)
+			if (m_atlas[i] == subtexture.texture)
+				page = i;
+
+		written += stream.write<uint32_t>(it.codepoint);
+		written += stream.write<int32_t>(page);
+		written += stream.write<float>(subtexture.source.x);
+		written += stream.write<float>(subtexture.source.y);
+		written += stream.write<float>(subtexture.source.w);
+		written += stream.write<float>(subtexture.source.h);
+		written += stream.write<float>(subtexture.frame.x);
+		written += stream.write<float>(subtexture.frame.y);
+		written += stream.write<float>(subtexture.frame.w);
+		written += stream.write<float>(subtexture.frame.h);
+		written += stream.write<float>(it.character.advance);
+		written += stream.write<float>(it.character.offset.x);
+		written += stream.write<float>(it.character.offset.y);
+		expected += 52;
+	}
+
+	// kerning, already sorted
+	written += stream.write<uint32_t>(m_kerning.size());
+	expected += 4;
+
+	for (auto& it : m_kerning)
+	{
+		written += stream.write<uint64_t>(it.pair);
+		written += stream.write<float>(it.value);
+		expected += 12;
+	}
+
+	return written == expected;
+}
+
+bool SpriteFont::load(const char* file)
+{
+	FileStream fs(file, FileMode::Read);
+	return fs.is_readable() && load(fs);
+}
+
+bool SpriteFont::load(Stream& stream)
+{
+	if (!stream.is_readable())
+		return false;
+
+	// read the whole thing in at once
+	Vector<char> data;
+	{
+		int64_t length = stream.length() - stream.position();
+		if (length < (int64_t)sizeof(file_magic) + 32)
+			return false;
+
+		data.resize((int)length);
+		if (stream.read(data.data(), length) != length)
+			return false;
+	}
+
+	MemoryStream reader(data.data(), data.size());
+	auto remaining = [&]() { return reader.length() - reader.position(); };
+
+	char magic[sizeof(file_magic)];
+	reader.read(magic, sizeof(magic));
+	if (memcmp(magic, file_magic, sizeof(magic)) != 0 ||
+		reader.read<uint32_t>() != file_version)
+		return false;
+
+	int64_t name_length = reader.read<int32_t>();
+	if (name_length < 0 || remaining() < name_length + 24)
+		return false;
+
+	SpriteFont font;
+	font.name = reader.read_string((int)name_length);
+	font.size = reader.read<float>();
+	font.ascent = reader.read<float>();
+	font.descent = reader.read<float>();
+	font.line_gap = reader.read<float>();
+	font.sdf_padding = reader.read<int32_t>();
+
+	// atlas pages, uploaded straight from the file data when they're stored as-is
+	int64_t page_count = reader.read<uint32_t>();
+	auto format = atlas_format();
+	Vector<uint8_t> pixels;
+	Vector<Color> colors;
+
+	for (int64_t i = 0; i < page_count; i++)
+	{
+		if (remaining() < 18)
+			return false;
+
+		int width = reader.read<int32_t>();
+		int height = reader.read<int32_t>();
+		int channels = reader.read<uint8_t>();
+		bool compressed = reader.read<uint8_t>() != 0;
+		int64_t length = reader.read<int64_t>();
+		int64_t count = (int64_t)width * height;
+		int64_t start = reader.position();
+
+		if (width <= 0 || height <= 0 || width > 16384 || height > 16384 ||
+			(channels != 1 && channels != 4) || length < 0 || remaining() < length ||
+			(!compressed && length != count * channels))
+			return false;
+
+		unsigned char* data = (unsigned char*)(reader.data() + start);
+		if (compressed)
 		{
-			auto kern = font.get_kerning(a->second, b->second, scale);
-			if (kern != 0)
-				set_kerning(a->first, b->first, kern);
+			pixels.resize((int)(count * channels));
+			InflateStream inflate(reader, length);
+			if (inflate.read(pixels.data(), pixels.size()) != pixels.size())
+				return false;
+			data = pixels.data();
 		}
+
+		// single-channel pages are expanded when the renderer can't draw them as coverage
+		auto texture = Texture::create(width, height, channels == 1 ? format : TextureFormat::RGBA);
+		if (texture && channels == 1)
+			set_coverage(texture, RectI(0, 0, width, height), data, font.sdf_padding > 0, colors);
+		else if (texture)
+			texture->set_data(data);
+
+		font.m_atlas.push_back(texture);
+		reader.seek(start + length);
+	}
+
+	// characters
+	if (remaining() < 4)
+		return false;
+
+	int64_t character_count = reader.read<uint32_t>();
+	if (remaining() < character_count * 52 + 4)
+		return false;
+
+	for (int64_t i = 0; i < character_count; i++)
+	{
+		uint32_t codepoint = reader.read<uint32_t>();
+		int page = reader.read<int32_t>();
+		Rect source, frame;
+		source.x = reader.read<float>();
+		source.y = reader.read<float>();
+		source.w = reader.read<float>();
+		source.h = reader.read<float>();
+		frame.x = reader.read<float>();
+		frame.y = reader.read<float>();
+		frame.w = reader.read<float>();
+		frame.h = reader.read<float>();
+
+		if (page >= page_count)
+			return false;
+
+		auto& character = font.m_characters[font.insert(codepoint)].character;
+		character.advance = reader.read<float>();
+		character.offset.x = reader.read<float>();
+		character.offset.y = reader.read<float>();
+
+		if (page >= 0)
+			character.subtexture = Subtexture(font.m_atlas[page], source, frame);
+	}
+
+	// kerning
+	int64_t kerning_count = reader.read<uint32_t>();
+	if (remaining() != kerning_count * 12)
+		return false;
+
+	for (int64_t i = 0; i < kerning_count; i++)
+	{
+		Kerning kerning;
+		kerning.pair = reader.read<uint64_t>();
+		kerning.value = reader.read<float>();
+
+		if (i > 0 && kerning.pair <= font.m_kerning.back().pair)
+			return false;
+
+		font.m_kerning.push_back(kerning);
+		font.m_characters[font.insert((uint32_t)(kerning.pair >> 32))].kerning = true;
+	}
+
+	*this = std::move(font);
+	return true;
+}
+
+void SpriteFont::build_dynamic(const char* file, float sz, int page_size, int max_pages, int sdf_padding)
+{
+	dispose();
+
+	Font font(file);
+	if (font.is_valid())
+		build_dynamic(std::move(font), sz, page_size, max_pages, sdf_padding);
+}
+
+void SpriteFont::build_dynamic(Font&& font, float size, int page_size, int max_pages, int sdf_padding)
+{
+	BLAH_ASSERT(page_size > 0 && max_pages > 0, "Dynamic SpriteFont needs at least one page");
+	BLAH_ASSERT(sdf_padding >= 0, "SDF padding can't be negative");
+
+	dispose();
+
+	float scale = font.get_scale(size);
+
+	name = font.family_name();
+	ascent = font.ascent() * scale;
+	descent = font.descent() * scale;
+	line_gap = font.line_gap() * scale;
+	this->size = size;
+	this->sdf_padding = sdf_padding;
+
+	m_dynamic = new Dynamic();
+	m_dynamic->font = std::move(font);
+	m_dynamic->scale = scale;
+	m_dynamic->page_size = page_size;
+	m_dynamic->max_pages = max_pages;
+}
+
+void SpriteFont::prepare(const String& text) const
+{
+	if (!m_dynamic)
+		return;
+
+	for (int i = 0; i < text.length(); i++)
+	{
+		if (text[i] != '\n')
+			find(text.utf8_at(i), true);
+		i += text.utf8_length(i) - 1;
+	}
 }
 
 float SpriteFont::get_kerning(uint32_t codepoint0, uint32_t codepoint1) const
 {
-	uint64_t index = ((uint64_t)codepoint0 << 32) | codepoint1;
+	// most characters don't start any pair, so they skip the search
+	int first = find_index(codepoint0);
+	if (first >= 0 && m_characters[first].kerning)
+	{
+		uint64_t pair = ((uint64_t)codepoint0 << 32) | codepoint1;
+		int index = find_kerning(pair);
+		if (index < m_kerning.size() && m_kerning[index].pair == pair)
+			return m_kerning[index].value;
+	}
+
+	// dynamic fonts look kerning up as it's needed, instead of storing every pair
+	if (m_dynamic)
+	{
+		int a = m_dynamic->lookup(insert(codepoint0), *this).glyph;
+		int b = m_dynamic->lookup(insert(codepoint1), *this).glyph;
+		if (a > 0 && b > 0)
+			return m_dynamic->font.get_kerning(a, b, m_dynamic->scale);
+	}
 
-	auto it = m_kerning.find(index);
-	if (it != m_kerning.end())
-		return it->second;
 	return 0.0f;
 }
 
 void SpriteFont::set_kerning(uint32_t codepoint0, uint32_t codepoint1, float value)
 {
-	uint64_t index = ((uint64_t)codepoint0 << 32) | codepoint1;
+	uint64_t pair = ((uint64_t)codepoint0 << 32) | codepoint1;
+	int index = find_kerning(pair);
+	bool exists = (index < m_kerning.size() && m_kerning[index].pair == pair);
 
 	if (value == 0)
 	{
-		m_kerning.erase(index);
+		if (exists)
+			m_kerning.erase(index);
+	}
+	else if (exists)
+	{
+		m_kerning[index].value = value;
 	}
 	else
 	{
-		m_kerning[index] = value;
+		m_characters[insert(codepoint0)].kerning = true;
+
+		// shift the later pairs up to keep them sorted
+		m_kerning.expand(1);
+		for (int i = m_kerning.size() - 1; i > index; i--)
+			m_kerning[i] = m_kerning[i - 1];
+		m_kerning[index].pair = pair;
+		m_kerning[index].value = value;
 	}
 }
 
-const SpriteFont::Character& SpriteFont::get_character(uint32_t codepoint) const
+int SpriteFont::find_kerning(uint64_t pair) const
+{
+	// index of the first pair that isn't less than the one given
+	int low = 0;
+	int high = m_kerning.size();
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (m_kerning[mid].pair < pair)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+int SpriteFont::find_index(uint32_t codepoint) const
+{
+	if (codepoint < direct_count)
+		return (codepoint < (uint32_t)m_direct.size() ? m_direct[codepoint] : -1);
+
+	if (m_table.size() <= 0)
+		return -1;
+
+	uint32_t mask = m_table.size() - 1;
+	for (uint32_t slot = hash_codepoint(codepoint) & mask; m_table[slot] >= 0; slot = (slot + 1) & mask)
+		if (m_characters[m_table[slot]].codepoint == codepoint)
+			return m_table[slot];
+
+	return -1;
+}
+
+int SpriteFont::insert(uint32_t codepoint) const
+{
+	int index = find_index(codepoint);
+	if (index >= 0)
+		return index;
+
+	index = m_characters.size();
+	m_characters.expand(1)->codepoint = codepoint;
+
+	if (codepoint < direct_count)
+	{
+		// grow the direct table in small steps, so fonts that only use ASCII stay small
+		if (codepoint >= (uint32_t)m_direct.size())
+		{
+			int from = m_direct.size();
+			m_direct.resize((codepoint + 128) & ~127);
+			for (int i = from; i < m_direct.size(); i++)
+				m_direct[i] = -1;
+		}
+
+		m_direct[codepoint] = index;
+		return index;
+	}
+
+	// keep the open addressing table at most half full
+	if (m_characters.size() * 2 > m_table.size())
+	{
+		int size = (m_table.size() > 0 ? m_table.size() * 2 : 64);
+		while (size < m_characters.size() * 2)
+			size *= 2;
+
+		m_table.resize(size);
+		for (auto& it : m_table)
+			it = -1;
+
+		for (int i = 0; i < m_characters.size(); i++)
+			if (m_characters[i].codepoint >= direct_count)
+			{
+				uint32_t slot = hash_codepoint(m_characters[i].codepoint) & (size - 1);
+				while (m_table[slot] >= 0)
+					slot = (slot + 1) & (size - 1);
+				m_table[slot] = i;
+			}
+
+		return index;
+	}
+
+	uint32_t mask = m_table.size() - 1;
+	uint32_t slot = hash_codepoint(codepoint) & mask;
+	while (m_table[slot] >= 0)
+		slot = (slot + 1) & mask;
+	m_table[slot] = index;
+
+	return index;
+}
+
+const SpriteFont::Character& SpriteFont::find(uint32_t codepoint, bool rasterize) const
 {
 	static const Character empty;
-	auto it = m_characters.find(codepoint);
-	if (it != m_characters.end())
-		return it->second;
+
+	if (m_dynamic)
+	{
+		// dynamic fonts keep an entry for every character requested, even missing ones
+		int index = insert(codepoint);
+		auto& glyph = m_dynamic->lookup(index, *this);
+		if (glyph.glyph <= 0)
+			return empty;
+
+		if (rasterize)
+		{
+			glyph.frame = Time::ticks;
+
+			if (glyph.page >= 0)
+				m_dynamic->touch(index);
+			else if (glyph.ch.has_glyph)
+				m_dynamic->rasterize(index, *this);
+		}
+
+		return m_characters[index].character;
+	}
+
+	int index = find_index(codepoint);
+	if (index >= 0)
+		return m_characters[index].character;
 	return empty;
 }
 
+SpriteFont::Character& SpriteFont::get_character(uint32_t codepoint)
+{
+	if (m_dynamic)
+		find(codepoint, true);
+	return m_characters[insert(codepoint)].character;
+}
+
+const SpriteFont::Character& SpriteFont::get_character(uint32_t codepoint) const
+{
+	return find(codepoint, true);
+}
+
+SpriteFont::Character& SpriteFont::operator[](uint32_t codepoint)
+{
+	if (m_dynamic)
+		find(codepoint, true);
+	return m_characters[insert(codepoint)].character;
+}
+
 const SpriteFont::Character& SpriteFont::operator[](uint32_t codepoint) const
 {
-	static const Character empty;
-	auto it = m_characters.find(codepoint);
-	if (it != m_characters.end())
-		return it->second;
-	return empty;
-}
\ No newline at end of file
+	return find(codepoint, true);
+}
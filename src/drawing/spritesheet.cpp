@@ -0,0 +1,277 @@
+#include <blah/drawing/spritesheet.h>
+#include <blah/images/imageops.h>
+#include <blah/graphics/texture.h>
+
+using namespace Blah;
+
+namespace
+{
+	constexpr uint64_t empty_id = ~0ULL;
+
+	uint64_t hash_bytes(uint64_t hash, const void* data, int64_t length)
+	{
+		auto bytes = (const uint8_t*)data;
+
+		for (; length >= 8; length -= 8, bytes += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes, 8);
+			hash = (hash ^ word) * 0x100000001b3ULL;
+			hash ^= hash >> 29;
+		}
+
+		for (; length > 0; length--, bytes++)
+			hash = (hash ^ *bytes) * 0x100000001b3ULL;
+
+		return hash;
+	}
+
+	// hashes the pixels inside the bounds, but not where they are
+	uint64_t hash_trimmed(const Color* pixels, int stride, const RectI& bounds)
+	{
+		int32_t size[2] = { bounds.w, bounds.h };
+		uint64_t hash = hash_bytes(0xcbf29ce484222325ULL, size, sizeof(size));
+
+		for (int y = bounds.y; y < bounds.y + bounds.h; y++)
+			hash = hash_bytes(hash, pixels + bounds.x + (int64_t)y * stride, sizeof(Color) * bounds.w);
+
+		return hash;
+	}
+
+	// returns the earlier frame that every cel of this frame links to, or -1
+	int linked_frame(const Aseprite& aseprite, int index)
+	{
+		auto& cels = aseprite.frames[index].cels;
+		if (cels.size() <= 0)
+			return -1;
+
+		int linked = cels[0].linked_frame_index;
+		if (linked < 0 || linked >= index)
+			return -1;
+
+		for (auto& it : cels)
+			if (it.linked_frame_index != linked)
+				return -1;
+
+		if (aseprite.frames[linked].cels.size() != cels.size())
+			return -1;
+
+		return linked;
+	}
+}
+
+size_t SpriteSheet::PlacementHash::operator()(const Placement& it) const
+{
+	int32_t values[4] = { it.frame.x, it.frame.y, it.frame.w, it.frame.h };
+	return (size_t)hash_bytes(it.id, values, sizeof(values));
+}
+
+const SpriteSheet::Animation* SpriteSheet::Sprite::get_animation(const String& name) const
+{
+	for (auto& it : animations)
+		if (it.name == name)
+			return &it;
+	return nullptr;
+}
+
+const SpriteSheet::Slice* SpriteSheet::Sprite::get_slice(const String& name) const
+{
+	for (auto& it : slices)
+		if (it.name == name)
+			return &it;
+	return nullptr;
+}
+
+SpriteSheet::SpriteSheet()
+{
+	packer.spacing = 0;
+	packer.padding = 1;
+}
+
+SpriteSheet::SpriteSheet(SpriteSheet&& src) noexcept
+{
+	packer = std::move(src.packer);
+	sprites = std::move(src.sprites);
+	subtextures = std::move(src.subtextures);
+	textures = std::move(src.textures);
+	m_placements = std::move(src.m_placements);
+	m_unique_count = src.m_unique_count;
+	m_unique = std::move(src.m_unique);
+	m_subtextures = std::move(src.m_subtextures);
+}
+
+SpriteSheet& SpriteSheet::operator=(SpriteSheet&& src) noexcept
+{
+	packer = std::move(src.packer);
+	sprites = std::move(src.sprites);
+	subtextures = std::move(src.subtextures);
+	textures = std::move(src.textures);
+	m_placements = std::move(src.m_placements);
+	m_unique_count = src.m_unique_count;
+	m_unique = std::move(src.m_unique);
+	m_subtextures = std::move(src.m_subtextures);
+	return *this;
+}
+
+void SpriteSheet::add(const String& name, const Aseprite& aseprite)
+{
+	Sprite sprite;
+	sprite.name = name;
+	sprite.width = aseprite.width;
+	sprite.height = aseprite.height;
+
+	Vector<Color> canvas;
+	if (aseprite.lazy())
+		canvas.resize(aseprite.width * aseprite.height);
+
+	for (int i = 0; i < aseprite.frames.size(); i++)
+	{
+		Frame frame;
+		frame.duration = aseprite.frames[i].duration / 1000.0f;
+
+		// frames made entirely of linked cels look the same as the frame they link to
+		int linked = linked_frame(aseprite, i);
+		if (linked >= 0)
+		{
+			frame.subtexture = sprite.frames[linked].subtexture;
+			sprite.frames.push_back(frame);
+			continue;
+		}
+
+		const Color* pixels = aseprite.frames[i].image.pixels;
+		if (aseprite.lazy())
+		{
+			aseprite.render_frame(i, canvas.data());
+			pixels = canvas.data();
+		}
+
+		// find the packed image with the same trimmed pixels, or add a new one
+		Placement placement;
+		RectI bounds;
+
+		if (pixels != nullptr && ImageOps::alpha_bounds(pixels, aseprite.width, aseprite.height, &bounds))
+		{
+			// hashes can collide, so the pixels are compared too
+			auto& bucket = m_unique[hash_trimmed(pixels, aseprite.width, bounds)];
+			placement.id = empty_id;
+
+			for (auto& it : bucket)
+			{
+				if (packer.same_pixels(it.entry, pixels, aseprite.width, bounds))
+				{
+					placement.id = it.id;
+					break;
+				}
+			}
+
+			if (placement.id == empty_id)
+			{
+				Unique unique;
+				unique.id = m_unique_count++;
+				unique.entry = packer.entries.size();
+				bucket.push_back(unique);
+
+				placement.id = unique.id;
+				packer.add(placement.id, aseprite.width, aseprite.height, pixels);
+			}
+
+			placement.frame = RectI(-bounds.x, -bounds.y, aseprite.width, aseprite.height);
+		}
+		else
+		{
+			placement.id = empty_id;
+			placement.frame = RectI(0, 0, aseprite.width, aseprite.height);
+		}
+
+		// share the subtexture with any frame drawing the same image at the same offset
+		auto existing = m_subtextures.find(placement);
+
+		if (existing == m_subtextures.end())
+		{
+			frame.subtexture = m_placements.size();
+			m_subtextures[placement] = frame.subtexture;
+			m_placements.push_back(placement);
+		}
+		else
+		{
+			frame.subtexture = existing->second;
+		}
+
+		sprite.frames.push_back(frame);
+	}
+
+	for (auto& tag : aseprite.tags)
+	{
+		Animation animation;
+		animation.name = tag.name;
+		animation.loops = tag.loops;
+
+		for (int i = tag.from; i <= tag.to && i < sprite.frames.size(); i++)
+			animation.frames.push_back(sprite.frames[i]);
+
+		sprite.animations.push_back(std::move(animation));
+	}
+
+	for (auto& it : aseprite.slices)
+	{
+		Slice slice;
+		slice.name = it.name;
+		slice.frame = it.frame;
+		slice.bounds = RectI(it.origin.x, it.origin.y, it.width, it.height);
+		slice.has_pivot = it.has_pivot;
+		slice.pivot = it.pivot;
+		sprite.slices.push_back(slice);
+	}
+
+	sprites.push_back(std::move(sprite));
+}
+
+void SpriteSheet::build()
+{
+	// subtextures can't be drawn rotated
+	packer.allow_rotation = false;
+	packer.pack();
+
+	textures.clear();
+	for (auto& it : packer.pages)
+		textures.push_back(Texture::create(it));
+
+	std::unordered_map<uint64_t, int> entries;
+	for (int i = 0; i < packer.entries.size(); i++)
+		entries[packer.entries[i].id] = i;
+
+	subtextures.clear();
+	for (auto& it : m_placements)
+	{
+		auto entry = entries.find(it.id);
+		if (entry != entries.end() && !packer.entries[entry->second].empty)
+		{
+			auto& packed = packer.entries[entry->second];
+			subtextures.push_back(Subtexture(textures[packed.page], packed.packed, it.frame));
+		}
+		else
+		{
+			subtextures.push_back(Subtexture(TextureRef(), Rect(0, 0, 0, 0), it.frame));
+		}
+	}
+}
+
+const SpriteSheet::Sprite* SpriteSheet::get(const String& name) const
+{
+	for (auto& it : sprites)
+		if (it.name == name)
+			return &it;
+	return nullptr;
+}
+
+void SpriteSheet::clear()
+{
+	packer.clear();
+	sprites.clear();
+	subtextures.clear();
+	textures.clear();
+	m_placements.clear();
+	m_unique_count = 0;
+	m_unique.clear();
+	m_subtextures.clear();
+}
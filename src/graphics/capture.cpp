@@ -0,0 +1,858 @@
+#include <blah/graphics/capture.h>
+#include <blah/core/app.h>
+#include <blah/core/log.h>
+#include <blah/math/stopwatch.h>
+#include <blah/streams/stream.h>
+#include "../internal/capture.h"
+#include "../internal/graphics_backend.h"
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace Blah;
+
+namespace
+{
+	constexpr char capture_magic[8] = { 'B', 'L', 'A', 'H', 'C', 'A', 'P', 'T' };
+	constexpr uint32_t capture_version = 2;
+
+	enum class Record : uint8_t
+	{
+		End,
+		Frame,
+		Shader,
+		Mesh,
+		Texture,
+		TextureData,
+		TextureUpdate,
+		FrameBuffer,
+		IndexData,
+		VertexData,
+		InstanceData,
+		Clear,
+		Render,
+		TextureRegion
+	};
+
+	struct Resource
+	{
+		int id = 0;
+		bool has_indices = false;
+		bool has_vertices = false;
+	};
+
+	Stream* capture_stream = nullptr;
+	std::unordered_map<const void*, Resource> capture_resources;
+	std::unordered_set<uint64_t> capture_hashes;
+	Vector<unsigned char> capture_pixels;
+	Vector<int> capture_textures;
+	int capture_next_id = 1;
+	bool capture_warned = false;
+
+	uint64_t calc_hash(const void* data, int64_t length)
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ULL;
+		auto bytes = (const unsigned char*)data;
+		for (int64_t i = 0; i < length; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+
+		// 0 is reserved for "no contents"
+		return hash != 0 ? hash : 1;
+	}
+
+	int calc_uniform_size(const UniformInfo& uniform)
+	{
+		switch (uniform.type)
+		{
+		case UniformType::Float: return uniform.array_length;
+		case UniformType::Float2: return uniform.array_length * 2;
+		case UniformType::Float3: return uniform.array_length * 3;
+		case UniformType::Float4: return uniform.array_length * 4;
+		case UniformType::Mat3x2: return uniform.array_length * 6;
+		case UniformType::Mat4x4: return uniform.array_length * 16;
+		default: return 0;
+		}
+	}
+
+	void write_record(Record record)
+	{
+		capture_stream->write<uint8_t>((uint8_t)record);
+	}
+
+	void write_string(const String& str)
+	{
+		capture_stream->write<int32_t>(str.length());
+		capture_stream->write(str);
+	}
+
+	void write_rect(const Rect& rect)
+	{
+		capture_stream->write<float>(rect.x);
+		capture_stream->write<float>(rect.y);
+		capture_stream->write<float>(rect.w);
+		capture_stream->write<float>(rect.h);
+	}
+
+	void write_vertex_format(const VertexFormat& format)
+	{
+		capture_stream->write<int32_t>(format.stride);
+		capture_stream->write<int32_t>(format.attributes.size());
+		for (auto& it : format.attributes)
+		{
+			capture_stream->write<int32_t>(it.index);
+			capture_stream->write<int32_t>((int32_t)it.type);
+			capture_stream->write<uint8_t>(it.normalized ? 1 : 0);
+		}
+	}
+
+	// writes the given contents, unless identical contents were already written
+	uint64_t write_texture_data(const void* data, int64_t length)
+	{
+		auto hash = calc_hash(data, length);
+
+		if (capture_hashes.insert(hash).second)
+		{
+			write_record(Record::TextureData);
+			capture_stream->write<uint64_t>(hash);
+			capture_stream->write<int64_t>(length);
+			capture_stream->write(data, length);
+		}
+
+		return hash;
+	}
+
+	Resource* find_resource(const void* resource)
+	{
+		auto it = capture_resources.find(resource);
+		if (it != capture_resources.end())
+			return &it->second;
+		return nullptr;
+	}
+
+	Resource* add_resource(const void* resource)
+	{
+		auto& entry = capture_resources[resource];
+		entry = Resource();
+		entry.id = capture_next_id++;
+		return &entry;
+	}
+
+	int capture_shader(const Shader* shader)
+	{
+		if (auto entry = find_resource(shader))
+			return entry->id;
+
+		auto entry = add_resource(shader);
+		auto& data = shader->data();
+
+		write_record(Record::Shader);
+		capture_stream->write<int32_t>(entry->id);
+		write_string(data.vertex);
+		write_string(data.fragment);
+		capture_stream->write<int32_t>(data.hlsl_attributes.size());
+		for (auto& it : data.hlsl_attributes)
+		{
+			write_string(it.semantic_name != nullptr ? it.semantic_name : "");
+			capture_stream->write<int32_t>(it.semantic_index);
+		}
+
+		return entry->id;
+	}
+
+	Resource* capture_mesh(const Mesh* mesh)
+	{
+		if (auto entry = find_resource(mesh))
+			return entry;
+
+		auto entry = add_resource(mesh);
+		write_record(Record::Mesh);
+		capture_stream->write<int32_t>(entry->id);
+		return entry;
+	}
+
+	int capture_texture(const Texture* texture)
+	{
+		if (auto entry = find_resource(texture))
+			return entry->id;
+
+		auto entry = add_resource(texture);
+		auto format = texture->format();
+
+		// Textures are recorded with whatever they contain when they're first drawn with.
+		// FrameBuffer attachments that haven't been drawn to yet end up here too, as a snapshot.
+		uint64_t hash = 0;
+		if (format != TextureFormat::DepthStencil && texture->is_resident())
+		{
+			capture_pixels.resize((int)GraphicsBackend::texture_size(texture->width(), texture->height(), format));
+			((Texture*)texture)->get_data(capture_pixels.data());
+			hash = write_texture_data(capture_pixels.data(), capture_pixels.size());
+		}
+
+		write_record(Record::Texture);
+		capture_stream->write<int32_t>(entry->id);
+		capture_stream->write<int32_t>(texture->width());
+		capture_stream->write<int32_t>(texture->height());
+		capture_stream->write<int32_t>((int32_t)format);
+		capture_stream->write<uint64_t>(hash);
+		return entry->id;
+	}
+
+	int capture_framebuffer(const FrameBuffer* framebuffer)
+	{
+		if (framebuffer == App::backbuffer.get())
+			return 0;
+
+		if (auto entry = find_resource(framebuffer))
+			return entry->id;
+
+		auto entry = add_resource(framebuffer);
+		auto& attachments = framebuffer->attachments();
+
+		write_record(Record::FrameBuffer);
+		capture_stream->write<int32_t>(entry->id);
+		capture_stream->write<int32_t>(framebuffer->width());
+		capture_stream->write<int32_t>(framebuffer->height());
+		capture_stream->write<int32_t>(attachments.size());
+
+		// attachments get their own ids, replacing any earlier snapshot of them
+		for (auto& it : attachments)
+		{
+			auto attachment = add_resource(it.get());
+			capture_stream->write<int32_t>((int32_t)it->format());
+			capture_stream->write<int32_t>(attachment->id);
+		}
+
+		return entry->id;
+	}
+
+	void reset_capture()
+	{
+		capture_stream = nullptr;
+		capture_resources.clear();
+		capture_hashes.clear();
+		capture_pixels.dispose();
+		capture_textures.dispose();
+		capture_next_id = 1;
+		capture_warned = false;
+	}
+}
+
+bool Capture::begin(Stream& stream)
+{
+	if (capture_stream != nullptr)
+	{
+		Log::warn("A capture is already running");
+		return false;
+	}
+
+	if (!stream.is_writable())
+	{
+		Log::error("Capture Stream is not writable");
+		return false;
+	}
+
+	reset_capture();
+	capture_stream = &stream;
+	capture_stream->write(capture_magic, sizeof(capture_magic));
+	capture_stream->write<uint32_t>(capture_version);
+	return true;
+}
+
+void Capture::end()
+{
+	if (capture_stream == nullptr)
+		return;
+
+	write_record(Record::End);
+	reset_capture();
+}
+
+bool Capture::is_capturing()
+{
+	return capture_stream != nullptr;
+}
+
+void Capture::on_render(const RenderPass& pass)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	// register everything the pass references before writing the pass itself
+	auto mesh = capture_mesh(pass.mesh.get());
+	if (!mesh->has_indices || !mesh->has_vertices)
+	{
+		if (!capture_warned)
+			Log::warn("A Mesh was drawn that wasn't uploaded during the capture; its RenderPasses are not recorded");
+		capture_warned = true;
+		return;
+	}
+
+	auto& material = pass.material;
+	auto shader = material->shader();
+	auto target = capture_framebuffer(pass.target.get());
+	auto shader_id = capture_shader(shader.get());
+
+	capture_textures.clear();
+	for (auto& it : material->textures())
+		capture_textures.push_back(it ? capture_texture(it.get()) : 0);
+
+	int64_t float_count = 0;
+	for (auto& it : shader->uniforms())
+		float_count += calc_uniform_size(it);
+
+	write_record(Record::Render);
+	capture_stream->write<int32_t>(target);
+	capture_stream->write<int32_t>(mesh->id);
+	capture_stream->write<int32_t>(shader_id);
+
+	capture_stream->write<int32_t>(capture_textures.size());
+	for (auto& it : capture_textures)
+		capture_stream->write<int32_t>(it);
+
+	capture_stream->write<int32_t>(material->samplers().size());
+	for (auto& it : material->samplers())
+	{
+		capture_stream->write<uint8_t>((uint8_t)it.filter);
+		capture_stream->write<uint8_t>((uint8_t)it.wrap_x);
+		capture_stream->write<uint8_t>((uint8_t)it.wrap_y);
+	}
+
+	capture_stream->write<int64_t>(float_count);
+	capture_stream->write(material->data(), float_count * sizeof(float));
+
+	capture_stream->write<uint8_t>(pass.has_viewport ? 1 : 0);
+	write_rect(pass.viewport);
+	capture_stream->write<uint8_t>(pass.has_scissor ? 1 : 0);
+	write_rect(pass.scissor);
+	capture_stream->write<int64_t>(pass.index_start);
+	capture_stream->write<int64_t>(pass.index_count);
+	capture_stream->write<int64_t>(pass.instance_count);
+	capture_stream->write<int32_t>((int32_t)pass.depth);
+	capture_stream->write<int32_t>((int32_t)pass.cull);
+	capture_stream->write<int32_t>((int32_t)pass.blend.color_op);
+	capture_stream->write<int32_t>((int32_t)pass.blend.color_src);
+	capture_stream->write<int32_t>((int32_t)pass.blend.color_dst);
+	capture_stream->write<int32_t>((int32_t)pass.blend.alpha_op);
+	capture_stream->write<int32_t>((int32_t)pass.blend.alpha_src);
+	capture_stream->write<int32_t>((int32_t)pass.blend.alpha_dst);
+	capture_stream->write<int32_t>((int32_t)pass.blend.mask);
+	capture_stream->write<uint32_t>(pass.blend.rgba);
+}
+
+void Capture::on_clear(const FrameBuffer* framebuffer, Color color, float depth, uint8_t stencil, ClearMask mask)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	auto id = capture_framebuffer(framebuffer);
+
+	write_record(Record::Clear);
+	capture_stream->write<int32_t>(id);
+	capture_stream->write<uint8_t>(color.r);
+	capture_stream->write<uint8_t>(color.g);
+	capture_stream->write<uint8_t>(color.b);
+	capture_stream->write<uint8_t>(color.a);
+	capture_stream->write<float>(depth);
+	capture_stream->write<uint8_t>(stencil);
+	capture_stream->write<int32_t>((int32_t)mask);
+}
+
+void Capture::on_index_data(const Mesh* mesh, IndexFormat format, const void* indices, int64_t count)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	auto entry = capture_mesh(mesh);
+	entry->has_indices = true;
+
+	int64_t size = count * (format == IndexFormat::UInt32 ? 4 : 2);
+
+	write_record(Record::IndexData);
+	capture_stream->write<int32_t>(entry->id);
+	capture_stream->write<int32_t>((int32_t)format);
+	capture_stream->write<int64_t>(count);
+	capture_stream->write(indices, size);
+}
+
+void Capture::on_vertex_data(const Mesh* mesh, const VertexFormat& format, const void* vertices, int64_t count)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	auto entry = capture_mesh(mesh);
+	entry->has_vertices = true;
+
+	write_record(Record::VertexData);
+	capture_stream->write<int32_t>(entry->id);
+	write_vertex_format(format);
+	capture_stream->write<int64_t>(count);
+	capture_stream->write(vertices, count * format.stride);
+}
+
+void Capture::on_instance_data(const Mesh* mesh, const VertexFormat& format, const void* instances, int64_t count)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	auto entry = capture_mesh(mesh);
+
+	write_record(Record::InstanceData);
+	capture_stream->write<int32_t>(entry->id);
+	write_vertex_format(format);
+	capture_stream->write<int64_t>(count);
+	capture_stream->write(instances, count * format.stride);
+}
+
+void Capture::on_texture_data(const Texture* texture, const unsigned char* data)
+{
+	if (capture_stream == nullptr || data == nullptr)
+		return;
+
+	// Textures that haven't been drawn with yet are read back when they are
+	auto entry = find_resource(texture);
+	if (entry == nullptr)
+		return;
+
+	auto hash = write_texture_data(data, GraphicsBackend::texture_size(texture->width(), texture->height(), texture->format()));
+
+	write_record(Record::TextureUpdate);
+	capture_stream->write<int32_t>(entry->id);
+	capture_stream->write<uint64_t>(hash);
+}
+
+void Capture::on_texture_region(const Texture* texture, const RectI& bounds, const unsigned char* data, int stride)
+{
+	if (capture_stream == nullptr || data == nullptr || bounds.w <= 0 || bounds.h <= 0)
+		return;
+
+	auto entry = find_resource(texture);
+	if (entry == nullptr)
+		return;
+
+	// only the region is stored, with its rows packed together
+	int64_t row = (int64_t)bounds.w * GraphicsBackend::bytes_per_pixel(texture->format());
+	int64_t row_stride = (int64_t)stride * GraphicsBackend::bytes_per_pixel(texture->format());
+	capture_pixels.resize((int)(row * bounds.h));
+	for (int y = 0; y < bounds.h; y++)
+		memcpy(capture_pixels.data() + y * row, data + y * row_stride, (size_t)row);
+
+	auto hash = write_texture_data(capture_pixels.data(), capture_pixels.size());
+
+	write_record(Record::TextureRegion);
+	capture_stream->write<int32_t>(entry->id);
+	capture_stream->write<int32_t>(bounds.x);
+	capture_stream->write<int32_t>(bounds.y);
+	capture_stream->write<int32_t>(bounds.w);
+	capture_stream->write<int32_t>(bounds.h);
+	capture_stream->write<uint64_t>(hash);
+}
+
+void Capture::on_destroyed(const void* resource)
+{
+	if (capture_stream == nullptr)
+		return;
+
+	capture_resources.erase(resource);
+}
+
+void Capture::on_frame()
+{
+	if (capture_stream == nullptr)
+		return;
+
+	write_record(Record::Frame);
+}
+
+namespace
+{
+	struct ReplayResource
+	{
+		ShaderRef shader;
+		MaterialRef material;
+		MeshRef mesh;
+		TextureRef texture;
+		FrameBufferRef framebuffer;
+	};
+
+	Rect read_rect(Stream& stream)
+	{
+		Rect rect;
+		rect.x = stream.read<float>();
+		rect.y = stream.read<float>();
+		rect.w = stream.read<float>();
+		rect.h = stream.read<float>();
+		return rect;
+	}
+
+	String read_string(Stream& stream)
+	{
+		auto length = stream.read<int32_t>();
+		if (length <= 0 || length > stream.length() - stream.position())
+			return String();
+		return stream.read_string(length);
+	}
+
+	VertexFormat read_vertex_format(Stream& stream)
+	{
+		VertexFormat format;
+		format.stride = stream.read<int32_t>();
+
+		auto count = stream.read<int32_t>();
+		for (int i = 0; i < count && i < 16; i++)
+		{
+			VertexAttribute attribute;
+			attribute.index = stream.read<int32_t>();
+			attribute.type = (VertexType)stream.read<int32_t>();
+			attribute.normalized = stream.read<uint8_t>() != 0;
+			format.attributes.push_back(attribute);
+		}
+
+		return format;
+	}
+
+	bool read_bytes(Stream& stream, Vector<unsigned char>& into, int64_t length)
+	{
+		if (length < 0 || length > stream.length() - stream.position())
+			return false;
+
+		into.resize((int)length);
+		stream.read(into.data(), length);
+		return true;
+	}
+}
+
+bool Capture::replay(Stream& stream, ReplayStats* stats)
+{
+	char magic[sizeof(capture_magic)];
+	if (stream.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, capture_magic, sizeof(magic)) != 0)
+	{
+		Log::error("Stream is not a capture");
+		return false;
+	}
+
+	auto version = stream.read<uint32_t>();
+	if (version < 1 || version > capture_version)
+	{
+		Log::error("Unsupported capture version %i", version);
+		return false;
+	}
+
+	ReplayStats result;
+	Stopwatch total;
+	Stopwatch timer;
+
+	std::unordered_map<int, ReplayResource> resources;
+	std::unordered_map<uint64_t, Vector<unsigned char>> contents;
+	Vector<unsigned char> buffer;
+	Vector<int> textures;
+	Vector<TextureSampler> samplers;
+	bool ended = false;
+
+	auto set_contents = [&](const TextureRef& texture, uint64_t hash)
+	{
+		auto it = contents.find(hash);
+		if (texture && it != contents.end() &&
+			it->second.size() >= GraphicsBackend::texture_size(texture->width(), texture->height(), texture->format()))
+			texture->set_data(it->second.data());
+	};
+
+	while (!ended && stream.position() < stream.length())
+	{
+		auto record = (Record)stream.read<uint8_t>();
+
+		switch (record)
+		{
+		case Record::End:
+			ended = true;
+			break;
+
+		case Record::Frame:
+			result.frames++;
+			break;
+
+		case Record::Shader:
+		{
+			auto id = stream.read<int32_t>();
+
+			ShaderData data;
+			data.vertex = read_string(stream);
+			data.fragment = read_string(stream);
+
+			// ShaderData only points to the semantic names, so they have to outlive Shader::create
+			StackVector<String, 16> semantics;
+			auto count = stream.read<int32_t>();
+			for (int i = 0; i < count && i < 16; i++)
+			{
+				semantics.push_back(read_string(stream));
+				ShaderData::HLSL_Attribute attribute;
+				attribute.semantic_index = stream.read<int32_t>();
+				data.hlsl_attributes.push_back(attribute);
+			}
+			for (int i = 0; i < semantics.size(); i++)
+				data.hlsl_attributes[i].semantic_name = semantics[i].cstr();
+
+			auto& resource = resources[id];
+			resource.shader = Shader::create(data);
+			resource.material = resource.shader ? Material::create(resource.shader) : MaterialRef();
+			break;
+		}
+
+		case Record::Mesh:
+		{
+			auto id = stream.read<int32_t>();
+			resources[id].mesh = Mesh::create();
+			break;
+		}
+
+		case Record::Texture:
+		{
+			auto id = stream.read<int32_t>();
+			auto width = stream.read<int32_t>();
+			auto height = stream.read<int32_t>();
+			auto format = (TextureFormat)stream.read<int32_t>();
+			auto hash = stream.read<uint64_t>();
+
+			auto& resource = resources[id];
+			resource.texture = Texture::create(width, height, format);
+			set_contents(resource.texture, hash);
+			break;
+		}
+
+		case Record::TextureData:
+		{
+			auto hash = stream.read<uint64_t>();
+			auto length = stream.read<int64_t>();
+			if (!read_bytes(stream, contents[hash], length))
+				ended = true;
+			break;
+		}
+
+		case Record::TextureUpdate:
+		{
+			auto id = stream.read<int32_t>();
+			auto hash = stream.read<uint64_t>();
+			set_contents(resources[id].texture, hash);
+			break;
+		}
+
+		case Record::TextureRegion:
+		{
+			auto id = stream.read<int32_t>();
+			RectI rect;
+			rect.x = stream.read<int32_t>();
+			rect.y = stream.read<int32_t>();
+			rect.w = stream.read<int32_t>();
+			rect.h = stream.read<int32_t>();
+			auto hash = stream.read<uint64_t>();
+
+			auto& texture = resources[id].texture;
+			auto it = contents.find(hash);
+			if (texture && it != contents.end() && rect.w > 0 && rect.h > 0 &&
+				it->second.size() >= GraphicsBackend::texture_size(rect.w, rect.h, texture->format()))
+				texture->set_data(rect, it->second.data());
+			break;
+		}
+
+		case Record::FrameBuffer:
+		{
+			auto id = stream.read<int32_t>();
+			auto width = stream.read<int32_t>();
+			auto height = stream.read<int32_t>();
+			auto count = stream.read<int32_t>();
+
+			StackVector<TextureFormat, BLAH_ATTACHMENTS> formats;
+			StackVector<int, BLAH_ATTACHMENTS> ids;
+			for (int i = 0; i < count && i < BLAH_ATTACHMENTS; i++)
+			{
+				formats.push_back((TextureFormat)stream.read<int32_t>());
+				ids.push_back(stream.read<int32_t>());
+			}
+
+			auto framebuffer = FrameBuffer::create(width, height, formats.data(), formats.size());
+			resources[id].framebuffer = framebuffer;
+
+			if (framebuffer)
+			{
+				for (int i = 0; i < ids.size(); i++)
+					resources[ids[i]].texture = framebuffer->attachment(i);
+			}
+			break;
+		}
+
+		case Record::IndexData:
+		{
+			auto id = stream.read<int32_t>();
+			auto format = (IndexFormat)stream.read<int32_t>();
+			auto count = stream.read<int64_t>();
+			if (!read_bytes(stream, buffer, count * (format == IndexFormat::UInt32 ? 4 : 2)))
+			{
+				ended = true;
+				break;
+			}
+
+			auto& mesh = resources[id].mesh;
+			if (mesh)
+				mesh->index_data(format, buffer.data(), count);
+			break;
+		}
+
+		case Record::VertexData:
+		case Record::InstanceData:
+		{
+			auto id = stream.read<int32_t>();
+			auto format = read_vertex_format(stream);
+			auto count = stream.read<int64_t>();
+			if (!read_bytes(stream, buffer, count * format.stride))
+			{
+				ended = true;
+				break;
+			}
+
+			auto& mesh = resources[id].mesh;
+			if (mesh && record == Record::VertexData)
+				mesh->vertex_data(format, buffer.data(), count);
+			else if (mesh)
+				mesh->instance_data(format, buffer.data(), count);
+			break;
+		}
+
+		case Record::Clear:
+		{
+			auto id = stream.read<int32_t>();
+			Color color;
+			color.r = stream.read<uint8_t>();
+			color.g = stream.read<uint8_t>();
+			color.b = stream.read<uint8_t>();
+			color.a = stream.read<uint8_t>();
+			auto depth = stream.read<float>();
+			auto stencil = stream.read<uint8_t>();
+			auto mask = (ClearMask)stream.read<int32_t>();
+
+			auto target = (id == 0 ? App::backbuffer : resources[id].framebuffer);
+			if (target)
+				target->clear(color, depth, stencil, mask);
+			break;
+		}
+
+		case Record::Render:
+		{
+			RenderPass pass;
+			auto target = stream.read<int32_t>();
+			auto mesh = stream.read<int32_t>();
+			auto shader = stream.read<int32_t>();
+
+			pass.target = (target == 0 ? App::backbuffer : resources[target].framebuffer);
+			pass.mesh = resources[mesh].mesh;
+			pass.material = resources[shader].material;
+
+			// the Material stores Textures & Samplers in uniform order, so set them the same way
+			auto texture_count = stream.read<int32_t>();
+			textures.clear();
+			for (int i = 0; i < texture_count; i++)
+				textures.push_back(stream.read<int32_t>());
+
+			auto sampler_count = stream.read<int32_t>();
+			samplers.clear();
+			for (int i = 0; i < sampler_count; i++)
+			{
+				TextureSampler sampler;
+				sampler.filter = (TextureFilter)stream.read<uint8_t>();
+				sampler.wrap_x = (TextureWrap)stream.read<uint8_t>();
+				sampler.wrap_y = (TextureWrap)stream.read<uint8_t>();
+				samplers.push_back(sampler);
+			}
+
+			auto float_count = stream.read<int64_t>();
+			if (!read_bytes(stream, buffer, float_count * sizeof(float)))
+			{
+				ended = true;
+				break;
+			}
+
+			pass.has_viewport = stream.read<uint8_t>() != 0;
+			pass.viewport = read_rect(stream);
+			pass.has_scissor = stream.read<uint8_t>() != 0;
+			pass.scissor = read_rect(stream);
+			pass.index_start = stream.read<int64_t>();
+			pass.index_count = stream.read<int64_t>();
+			pass.instance_count = stream.read<int64_t>();
+			pass.depth = (Compare)stream.read<int32_t>();
+			pass.cull = (Cull)stream.read<int32_t>();
+			pass.blend.color_op = (BlendOp)stream.read<int32_t>();
+			pass.blend.color_src = (BlendFactor)stream.read<int32_t>();
+			pass.blend.color_dst = (BlendFactor)stream.read<int32_t>();
+			pass.blend.alpha_op = (BlendOp)stream.read<int32_t>();
+			pass.blend.alpha_src = (BlendFactor)stream.read<int32_t>();
+			pass.blend.alpha_dst = (BlendFactor)stream.read<int32_t>();
+			pass.blend.mask = (BlendMask)stream.read<int32_t>();
+			pass.blend.rgba = stream.read<uint32_t>();
+
+			if (!pass.target || !pass.mesh || !pass.material)
+			{
+				result.skipped++;
+				break;
+			}
+
+			auto& material = pass.material;
+			int texture_index = 0;
+			int texture_slot = 0;
+			int sampler_index = 0;
+			int sampler_slot = 0;
+			int64_t offset = 0;
+
+			for (auto& it : material->shader()->uniforms())
+			{
+				if (it.type == UniformType::Texture2D)
+				{
+					for (int i = 0; i < it.array_length && texture_index < textures.size(); i++, texture_index++)
+						material->set_texture(texture_slot, textures[texture_index] != 0 ? resources[textures[texture_index]].texture : TextureRef(), i);
+					texture_slot++;
+				}
+				else if (it.type == UniformType::Sampler2D)
+				{
+					for (int i = 0; i < it.array_length && sampler_index < samplers.size(); i++, sampler_index++)
+						material->set_sampler(sampler_slot, samplers[sampler_index], i);
+					sampler_slot++;
+				}
+				else
+				{
+					auto size = calc_uniform_size(it);
+					if (size > 0 && (offset + size) * (int64_t)sizeof(float) <= buffer.size())
+						material->set_value(it.name, (float*)buffer.data() + offset, size);
+					offset += size;
+				}
+			}
+
+			timer.reset();
+			GraphicsBackend::render(pass);
+			auto elapsed = timer.microseconds();
+
+			PassTiming timing;
+			timing.frame = result.frames;
+			timing.index_count = pass.index_count;
+			timing.instance_count = pass.instance_count;
+			timing.microseconds = elapsed;
+
+			result.passes_timing.push_back(timing);
+			result.render_microseconds += elapsed;
+			result.passes++;
+			break;
+		}
+
+		default:
+			Log::error("Invalid capture record %i", (int)record);
+			ended = true;
+			break;
+		}
+	}
+
+	result.total_microseconds = total.microseconds();
+
+	if (stats != nullptr)
+		*stats = std::move(result);
+
+	return true;
+}
@@ -1,5 +1,6 @@
 #include <blah/graphics/framebuffer.h>
 #include "../internal/graphics_backend.h"
+#include "../internal/capture.h"
 
 using namespace Blah;
 
@@ -33,3 +34,8 @@ FrameBufferRef FrameBuffer::create(int width, int height, const TextureFormat* a
 
 	return GraphicsBackend::create_framebuffer(width, height, attachments, attachment_count);
 }
+
+FrameBuffer::~FrameBuffer()
+{
+	Capture::on_destroyed(this);
+}
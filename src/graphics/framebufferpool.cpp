@@ -0,0 +1,132 @@
+#include <blah/graphics/framebufferpool.h>
+#include <blah/core/log.h>
+#include "../internal/graphics_backend.h"
+
+using namespace Blah;
+
+FrameBufferPool::FrameBufferPool()
+	: max_unused_frames(3), m_frame(0) {}
+
+FrameBufferPool::FrameBufferPool(int max_unused_frames)
+	: max_unused_frames(max_unused_frames), m_frame(0) {}
+
+FrameBufferPool::~FrameBufferPool()
+{
+	clear();
+}
+
+FrameBufferRef FrameBufferPool::request(int width, int height)
+{
+	static const TextureFormat attachment = TextureFormat::RGBA;
+	return request(width, height, &attachment, 1);
+}
+
+FrameBufferRef FrameBufferPool::request(int width, int height, const TextureFormat* attachments, int attachment_count)
+{
+	BLAH_ASSERT(attachment_count > 0 && attachment_count <= BLAH_ATTACHMENTS, "Invalid attachment count");
+
+	// find an unused FrameBuffer with a matching size & attachment list
+	for (auto& it : m_entries)
+	{
+		if (it.in_use ||
+			it.formats.size() != attachment_count ||
+			it.framebuffer->width() != width ||
+			it.framebuffer->height() != height)
+			continue;
+
+		bool matches = true;
+		for (int i = 0; i < attachment_count && matches; i++)
+			matches = (it.formats[i] == attachments[i]);
+
+		if (matches)
+		{
+			it.in_use = true;
+			it.last_used = m_frame;
+			return it.framebuffer;
+		}
+	}
+
+	// create a new one
+	auto framebuffer = FrameBuffer::create(width, height, attachments, attachment_count);
+	if (!framebuffer)
+		return FrameBufferRef();
+
+	Entry* entry = m_entries.expand();
+	entry->framebuffer = framebuffer;
+	entry->in_use = true;
+	entry->last_used = m_frame;
+	entry->memory = 0;
+
+	for (int i = 0; i < attachment_count; i++)
+	{
+		entry->formats.push_back(attachments[i]);
+		entry->memory += GraphicsBackend::texture_size(width, height, attachments[i]);
+	}
+
+	return framebuffer;
+}
+
+void FrameBufferPool::release(const FrameBufferRef& framebuffer)
+{
+	for (auto& it : m_entries)
+		if (it.framebuffer == framebuffer)
+		{
+			it.in_use = false;
+			return;
+		}
+
+	Log::warn("Trying to release a FrameBuffer that doesn't belong to the pool");
+}
+
+void FrameBufferPool::frame()
+{
+	// a negative setting releases everything that went unused this frame
+	uint64_t max_unused = (uint64_t)(max_unused_frames > 0 ? max_unused_frames : 0);
+
+	for (int i = m_entries.size() - 1; i >= 0; i--)
+	{
+		auto& it = m_entries[i];
+		it.in_use = false;
+
+		if (m_frame - it.last_used > max_unused)
+			m_entries.erase(i);
+	}
+
+	m_frame++;
+}
+
+void FrameBufferPool::clear()
+{
+	m_entries.clear();
+}
+
+int FrameBufferPool::count() const
+{
+	return m_entries.size();
+}
+
+int FrameBufferPool::in_use() const
+{
+	int result = 0;
+	for (auto& it : m_entries)
+		if (it.in_use)
+			result++;
+	return result;
+}
+
+int64_t FrameBufferPool::memory() const
+{
+	int64_t result = 0;
+	for (auto& it : m_entries)
+		result += it.memory;
+	return result;
+}
+
+int64_t FrameBufferPool::memory_in_use() const
+{
+	int64_t result = 0;
+	for (auto& it : m_entries)
+		if (it.in_use)
+			result += it.memory;
+	return result;
+}
@@ -335,7 +335,8 @@ const float* Material::get_value(const char* name, int64_t* length) const
 		offset += calc_uniform_size(uniform);
 	}
 
-	*length = 0;
+	if (length != nullptr)
+		*length = 0;
 	return nullptr;
 	Log::warn("No Uniform '%s' exists", name);
 }
@@ -1,5 +1,6 @@
 #include <blah/graphics/mesh.h>
 #include "../internal/graphics_backend.h"
+#include "../internal/capture.h"
 
 using namespace Blah;
 
@@ -9,6 +10,11 @@ MeshRef Mesh::create()
 	return GraphicsBackend::create_mesh();
 }
 
+Mesh::~Mesh()
+{
+	Capture::on_destroyed(this);
+}
+
 VertexFormat::VertexFormat(std::initializer_list<VertexAttribute> attributes, int stride)
 {
 	for (auto& it : attributes)
@@ -1,6 +1,8 @@
 #include <blah/graphics/renderpass.h>
+#include <blah/graphics/residency.h>
 #include <blah/core/log.h>
 #include "../internal/graphics_backend.h"
+#include "../internal/capture.h"
 
 using namespace Blah;
 
@@ -89,6 +91,11 @@ void RenderPass::perform()
 	if (pass.has_scissor)
 		pass.scissor = pass.scissor.overlap_rect(Rect(0, 0, draw_size.x, draw_size.y));
 
+	// make sure any evicted Textures are reloaded
+	for (auto& it : pass.material->textures())
+		Residency::touch(it.get());
+
 	// perform render
+	Capture::on_render(pass);
 	GraphicsBackend::render(pass);
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include <blah/graphics/residency.h>
+#include <blah/images/image.h>
+#include <blah/core/log.h>
+#include "../internal/graphics_backend.h"
+#include <unordered_map>
+#include <algorithm>
+
+using namespace Blah;
+
+namespace
+{
+	struct Entry
+	{
+		std::weak_ptr<Texture> texture;
+		const Texture* ptr = nullptr;
+		int64_t bytes = 0;
+		uint64_t last_used = 0;
+		bool pinned = false;
+
+		// reload sources (only one is used)
+		Image image;
+		FilePath path;
+		Residency::ReloadFn reload;
+	};
+
+	Vector<Entry> residency_entries;
+	std::unordered_map<const Texture*, int> residency_lookup;
+	Residency::Stats residency_stats;
+	uint64_t residency_frame = 0;
+	int residency_reloads = 0;
+
+	void residency_remove(int index);
+
+	Entry* residency_find(const Texture* texture)
+	{
+		auto it = residency_lookup.find(texture);
+		if (it == residency_lookup.end())
+			return nullptr;
+
+		// the tracked texture was destroyed and something else now lives at its address
+		if (residency_entries[it->second].texture.expired())
+		{
+			residency_remove(it->second);
+			return nullptr;
+		}
+
+		return &residency_entries[it->second];
+	}
+
+	Entry* residency_add(const TextureRef& texture, bool pinned)
+	{
+		BLAH_ASSERT(texture, "Trying to track an invalid Texture");
+		BLAH_ASSERT(!texture->is_framebuffer(), "FrameBuffer Textures can't be tracked");
+		BLAH_ASSERT(texture->format() == TextureFormat::RGBA, "Only RGBA Textures can be tracked");
+
+		// replace any existing entry
+		Entry* entry = residency_find(texture.get());
+		if (entry == nullptr)
+		{
+			residency_lookup[texture.get()] = residency_entries.size();
+			entry = residency_entries.expand();
+		}
+		else
+		{
+			entry->image.dispose();
+			entry->path.clear();
+			entry->reload = nullptr;
+		}
+
+		entry->texture = texture;
+		entry->ptr = texture.get();
+		entry->bytes = GraphicsBackend::texture_size(texture->width(), texture->height(), texture->format());
+		entry->last_used = residency_frame;
+		entry->pinned = pinned;
+		return entry;
+	}
+
+	void residency_remove(int index)
+	{
+		residency_lookup.erase(residency_entries[index].ptr);
+
+		// swap with the last entry
+		int last = residency_entries.size() - 1;
+		if (index != last)
+		{
+			auto& entry = residency_entries[index];
+			entry.image.dispose();
+			entry = std::move(residency_entries[last]);
+			residency_lookup[entry.ptr] = index;
+		}
+
+		residency_entries.erase(last);
+	}
+
+	bool residency_reload(Entry* entry, Texture* texture)
+	{
+		if (entry->image.pixels != nullptr)
+		{
+			texture->set_data((unsigned char*)entry->image.pixels);
+			return true;
+		}
+
+		Image image;
+		if (entry->path.length() > 0)
+			image = Image(entry->path.cstr());
+		else if (entry->reload && !entry->reload(image))
+			image.dispose();
+
+		if (image.pixels == nullptr)
+			return false;
+
+		if (image.width != texture->width() || image.height != texture->height())
+		{
+			Log::error("Reloaded Texture source is %ix%i, but the Texture is %ix%i", image.width, image.height, texture->width(), texture->height());
+			return false;
+		}
+
+		texture->set_data((unsigned char*)image.pixels);
+		return true;
+	}
+}
+
+void Residency::set_budget(int64_t bytes)
+{
+	residency_stats.budget = (bytes > 0 ? bytes : 0);
+}
+
+int64_t Residency::budget()
+{
+	return residency_stats.budget;
+}
+
+void Residency::track(const TextureRef& texture, const Image& source, bool pinned)
+{
+	if (!texture)
+		return;
+
+	BLAH_ASSERT(source.width == texture->width() && source.height == texture->height(), "Source Image must be the same size as the Texture");
+
+	auto entry = residency_add(texture, pinned);
+	entry->image = source;
+}
+
+void Residency::track(const TextureRef& texture, const FilePath& path, bool pinned)
+{
+	if (!texture)
+		return;
+
+	auto entry = residency_add(texture, pinned);
+	entry->path = path;
+}
+
+void Residency::track(const TextureRef& texture, const ReloadFn& reload, bool pinned)
+{
+	if (!texture)
+		return;
+
+	auto entry = residency_add(texture, pinned);
+	entry->reload = reload;
+}
+
+void Residency::untrack(const TextureRef& texture)
+{
+	if (residency_find(texture.get()) != nullptr)
+		residency_remove(residency_lookup[texture.get()]);
+}
+
+void Residency::pin(const TextureRef& texture, bool pinned)
+{
+	Entry* entry = residency_find(texture.get());
+	if (entry == nullptr)
+	{
+		Log::warn("Trying to pin a Texture that isn't tracked");
+		return;
+	}
+
+	entry->pinned = pinned;
+
+	// pinned textures must be resident
+	if (pinned)
+		touch(texture.get());
+}
+
+void Residency::touch(const Texture* texture)
+{
+	if (texture == nullptr || residency_entries.size() <= 0)
+		return;
+
+	Entry* entry = residency_find(texture);
+	if (entry == nullptr)
+		return;
+
+	entry->last_used = residency_frame;
+
+	if (!texture->is_resident())
+	{
+		if (residency_reload(entry, (Texture*)texture))
+		{
+			residency_reloads++;
+			residency_stats.reloaded_total++;
+		}
+		else
+		{
+			Log::warn("Failed to reload an evicted Texture");
+		}
+	}
+}
+
+void Residency::frame()
+{
+	residency_stats.evicted_last_frame = 0;
+
+	// remove textures that no longer exist, and total up what's resident
+	int64_t resident_bytes = 0;
+	for (int i = residency_entries.size() - 1; i >= 0; i--)
+	{
+		auto texture = residency_entries[i].texture.lock();
+		if (!texture)
+			residency_remove(i);
+		else if (texture->is_resident())
+			resident_bytes += residency_entries[i].bytes;
+	}
+
+	// evict least recently used textures until we're under budget
+	if (residency_stats.budget > 0 && resident_bytes > residency_stats.budget)
+	{
+		Vector<Entry*> candidates;
+		for (auto& it : residency_entries)
+		{
+			// anything drawn this frame may still be in flight, so leave it alone
+			if (it.pinned || it.last_used >= residency_frame)
+				continue;
+
+			auto texture = it.texture.lock();
+			if (texture && texture->is_resident())
+				candidates.push_back(&it);
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b)
+		{
+			return a->last_used < b->last_used;
+		});
+
+		for (int i = 0; i < candidates.size() && resident_bytes > residency_stats.budget; i++)
+		{
+			auto texture = candidates[i]->texture.lock();
+			texture->evict();
+			resident_bytes -= candidates[i]->bytes;
+
+			residency_stats.evicted_last_frame++;
+			residency_stats.evicted_total++;
+		}
+	}
+
+	residency_stats.reloaded_last_frame = residency_reloads;
+	residency_reloads = 0;
+	residency_frame++;
+}
+
+Residency::Stats Residency::stats()
+{
+	Stats result = residency_stats;
+	result.tracked_bytes = 0;
+	result.resident_bytes = 0;
+	result.pinned_bytes = 0;
+	result.tracked = 0;
+	result.resident = 0;
+	result.pinned = 0;
+
+	for (auto& it : residency_entries)
+	{
+		auto texture = it.texture.lock();
+		if (!texture)
+			continue;
+
+		result.tracked++;
+		result.tracked_bytes += it.bytes;
+
+		if (texture->is_resident())
+		{
+			result.resident++;
+			result.resident_bytes += it.bytes;
+		}
+
+		if (it.pinned)
+		{
+			result.pinned++;
+			result.pinned_bytes += it.bytes;
+		}
+	}
+
+	return result;
+}
@@ -1,6 +1,7 @@
 #include <blah/graphics/shader.h>
 #include <blah/core/app.h>
 #include "../internal/graphics_backend.h"
+#include "../internal/capture.h"
 
 using namespace Blah;
 
@@ -33,7 +34,26 @@ ShaderRef Shader::create(const ShaderData& data)
 					BLAH_ERROR_FMT("Shader Uniform names '%s' overlap! All Names must be unique.", uniforms[0].name.cstr());
 					return ShaderRef();
 				}
+
+		// keep a copy of the data, including the HLSL semantic names it only points to
+		shader->m_data = data;
+		for (int i = 0; i < data.hlsl_attributes.size(); i++)
+		{
+			auto name = data.hlsl_attributes[i].semantic_name;
+			shader->m_semantic_names.push_back(name != nullptr ? name : "");
+			shader->m_data.hlsl_attributes[i].semantic_name = shader->m_semantic_names[i].cstr();
+		}
 	}
 
 	return shader;
+}
+
+Shader::~Shader()
+{
+	Capture::on_destroyed(this);
+}
+
+const ShaderData& Shader::data() const
+{
+	return m_data;
 }
\ No newline at end of file
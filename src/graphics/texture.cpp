@@ -3,6 +3,7 @@
 #include <blah/streams/stream.h>
 #include <blah/core/log.h>
 #include "../internal/graphics_backend.h"
+#include "../internal/capture.h"
 
 using namespace Blah;
 
@@ -58,4 +59,9 @@ TextureRef Texture::create(const char* file)
 	}
 
 	return TextureRef();
-}
\ No newline at end of file
+}
+
+Texture::~Texture()
+{
+	Capture::on_destroyed(this);
+}
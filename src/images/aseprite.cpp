@@ -1,12 +1,11 @@
 #include <blah/images/aseprite.h>
+#include <blah/images/imageops.h>
+#include <blah/images/packer.h>
 #include <blah/streams/filestream.h>
+#include <blah/streams/inflatestream.h>
 #include <blah/core/filesystem.h>
 #include <blah/core/log.h>
 
-#define STBI_NO_STDIO
-#define STBI_ONLY_ZLIB
-#include "../third_party/stb_image.h"
-
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MUL_UN8(a, b, t) \
@@ -19,14 +18,16 @@ Aseprite::Aseprite()
 
 }
 
-Aseprite::Aseprite(const char* path)
+Aseprite::Aseprite(const char* path, bool lazy)
 {
+	m_lazy = lazy;
 	FileStream fs(path, FileMode::Read);
 	parse(fs);
 }
 
-Aseprite::Aseprite(Stream& stream)
+Aseprite::Aseprite(Stream& stream, bool lazy)
 {
+	m_lazy = lazy;
 	parse(stream);
 }
 
@@ -40,6 +41,9 @@ Aseprite::Aseprite(const Aseprite& src)
 	tags = src.tags;
 	slices = src.slices;
 	palette = src.palette;
+	cache_size = src.cache_size;
+	m_lazy = src.m_lazy;
+	m_cached = src.m_cached;
 }
 
 Aseprite::Aseprite(Aseprite&& src) noexcept
@@ -52,6 +56,9 @@ Aseprite::Aseprite(Aseprite&& src) noexcept
 	tags = std::move(src.tags);
 	slices = std::move(src.slices);
 	palette = std::move(src.palette);
+	cache_size = src.cache_size;
+	m_lazy = src.m_lazy;
+	m_cached = std::move(src.m_cached);
 }
 
 Aseprite& Aseprite::operator=(const Aseprite& src)
@@ -64,6 +71,9 @@ Aseprite& Aseprite::operator=(const Aseprite& src)
 	tags = src.tags;
 	slices = src.slices;
 	palette = src.palette;
+	cache_size = src.cache_size;
+	m_lazy = src.m_lazy;
+	m_cached = src.m_cached;
 	return *this;
 }
 
@@ -77,6 +87,9 @@ Aseprite& Aseprite::operator=(Aseprite&& src) noexcept
 	tags = std::move(src.tags);
 	slices = std::move(src.slices);
 	palette = std::move(src.palette);
+	cache_size = src.cache_size;
+	m_lazy = src.m_lazy;
+	m_cached = std::move(src.m_cached);
 	return *this;
 }
 
@@ -156,8 +169,9 @@ void Aseprite::parse(Stream& stream)
 				chunks = old_chunk_count;
 		}
 
-		// make frame image
-		frames[i].image = Image(width, height);
+		// make frame image, unless frames are composited on demand
+		if (!m_lazy)
+			frames[i].image = Image(width, height);
 
 		// frame chunks
 		for (unsigned int j = 0; j < chunks; j++)
@@ -239,21 +253,8 @@ void Aseprite::parse_cel(Stream& stream, int frameIndex, size_t maxPosition)
 		// DEFLATE (zlib)
 		else
 		{
-			// this could be optimized to use a buffer on the stack if we only read set chunks at a time
-			// stbi's zlib doesn't have that functionality though
-			auto size = maxPosition - stream.position();
-			if (size > INT32_MAX)
-				size = INT32_MAX;
-
-			char* buffer = new char[size];
-			stream.read(buffer, size);
-
-			int olen = width * height * sizeof(Color);
-			int res = stbi_zlib_decode_buffer((char*)cel.image.pixels, olen, buffer, (int)size);
-
-			delete[] buffer;
-
-			if (res < 0)
+			InflateStream inflate(stream, maxPosition - stream.position());
+			if (inflate.read(cel.image.pixels, count) != count)
 			{
 				BLAH_ERROR("Unable to parse Aseprite file");
 				return;
@@ -263,19 +264,9 @@ void Aseprite::parse_cel(Stream& stream, int frameIndex, size_t maxPosition)
 		// convert to pixels
 		// note: we work in-place to save having to store stuff in a buffer
 		if (mode == Modes::Grayscale)
-		{
-			auto src = (unsigned char*)cel.image.pixels;
-			auto dst = cel.image.pixels;
-			for (int d = width * height - 1, s = (width * height - 1) * 2; d >= 0; d--, s -= 2)
-				dst[d] = Color(src[s], src[s], src[s], src[s + 1]);
-		}
+			ImageOps::gray_to_rgba((uint8_t*)cel.image.pixels, cel.image.pixels, width * height);
 		else if (mode == Modes::Indexed)
-		{
-			auto src = (unsigned char*)cel.image.pixels;
-			auto dst = cel.image.pixels;
-			for (int i = width * height - 1; i >= 0; i--)
-				dst[i] = palette[src[i]];
-		}
+			ImageOps::indexed_to_rgba((uint8_t*)cel.image.pixels, cel.image.pixels, width * height, palette.data(), palette.size());
 
 	}
 	// REFERENCE
@@ -286,9 +277,9 @@ void Aseprite::parse_cel(Stream& stream, int frameIndex, size_t maxPosition)
 	}
 
 	// draw to frame if visible
-	if ((int)layers[cel.layer_index].flag & (int)LayerFlags::Visible)
+	if (!m_lazy && ((int)layers[cel.layer_index].flag & (int)LayerFlags::Visible))
 	{
-		render_cel(&cel, &frame);
+		render_cel(&cel, frame.image.pixels);
 	}
 
 	cel.userdata.color = 0xffffff;
@@ -406,9 +397,71 @@ void Aseprite::parse_slice(Stream& stream, int frame)
 	}
 }
 
-void Aseprite::render_cel(Cel* cel, Frame* frame)
+const Image& Aseprite::frame_image(int index)
+{
+	BLAH_ASSERT(index >= 0 && index < frames.size(), "Frame index is out of range");
+
+	auto& frame = frames[index];
+	if (!m_lazy)
+		return frame.image;
+
+	// move to the back of the cache, as the most recently used
+	for (int i = 0; i < m_cached.size(); i++)
+	{
+		if (m_cached[i] == index)
+		{
+			m_cached.erase(i);
+			break;
+		}
+	}
+
+	if (frame.image.pixels == nullptr)
+		frame.image = render_frame(index);
+
+	m_cached.push_back(index);
+
+	while (m_cached.size() > MAX(cache_size, 1))
+	{
+		frames[m_cached[0]].image.dispose();
+		m_cached.erase(0);
+	}
+
+	return frame.image;
+}
+
+void Aseprite::render_frame(int index, Color* pixels) const
 {
-	Layer& layer = layers[cel->layer_index];
+	BLAH_ASSERT(index >= 0 && index < frames.size(), "Frame index is out of range");
+
+	for (int i = 0; i < width * height; i++)
+		pixels[i] = Color::transparent;
+
+	for (auto& cel : frames[index].cels)
+		if ((int)layers[cel.layer_index].flag & (int)LayerFlags::Visible)
+			render_cel(&cel, pixels);
+}
+
+Image Aseprite::render_frame(int index) const
+{
+	Image image(width, height);
+	render_frame(index, image.pixels);
+	return image;
+}
+
+void Aseprite::render_frame(int index, Packer& packer, uint64_t id) const
+{
+	Image image = render_frame(index);
+	packer.add(id, image);
+}
+
+bool Aseprite::lazy() const
+{
+	return m_lazy;
+}
+
+void Aseprite::render_cel(const Cel* cel, Color* pixels) const
+{
+	const Layer& layer = layers[cel->layer_index];
 
 	while (cel->linked_frame_index >= 0)
 	{
@@ -431,9 +484,9 @@ void Aseprite::render_cel(Cel* cel, Frame* frame)
 	auto srcY = cel->y;
 	auto srcW = cel->image.width;
 	auto srcH = cel->image.height;
-	auto dst = frame->image.pixels;
-	auto dstW = frame->image.width;
-	auto dstH = frame->image.height;
+	auto dst = pixels;
+	auto dstW = width;
+	auto dstH = height;
 
 	// blit pixels
 	int left = MAX(0, srcX);
@@ -441,30 +494,19 @@ void Aseprite::render_cel(Cel* cel, Frame* frame)
 	int top = MAX(0, srcY);
 	int bottom = MIN(dstH, srcY + srcH);
 
-	if (layer.blendmode == 0)
-	{
-		for (int dx = left, sx = -MIN(srcX, 0); dx < right; dx++, sx++)
-		{
-			for (int dy = top, sy = -MIN(srcY, 0); dy < bottom; dy++, sy++)
-			{
-				Color* srcColor = (src + sx + sy * srcW);
-				Color* dstColor = (dst + dx + dy * dstW);
-
-				if (srcColor->a != 0)
-				{
-					auto sa = MUL_UN8(srcColor->a, opacity, t);
-					auto ra = dstColor->a + sa - MUL_UN8(dstColor->a, sa, t);
-
-					dstColor->r = (unsigned char)(dstColor->r + (srcColor->r - dstColor->r) * sa / ra);
-					dstColor->g = (unsigned char)(dstColor->g + (srcColor->g - dstColor->g) * sa / ra);
-					dstColor->b = (unsigned char)(dstColor->b + (srcColor->b - dstColor->b) * sa / ra);
-					dstColor->a = (unsigned char)ra;
-				}
-			}
-		}
-	}
-	else
+	if (right <= left)
+		return;
+
+	auto mode = ImageOps::Blend::Normal;
+	if (layer.blendmode > 0 && layer.blendmode < (int)ImageOps::Blend::Count)
+		mode = (ImageOps::Blend)layer.blendmode;
+	else if (layer.blendmode != 0)
+		Log::warn("Aseprite blendmode %i isn't supported, using Normal", layer.blendmode);
+
+	for (int dy = top, sy = -MIN(srcY, 0); dy < bottom; dy++, sy++)
 	{
-		BLAH_ERROR("Aseprite blendmodes aren't implemented");
+		auto srcRow = src + (-MIN(srcX, 0)) + sy * srcW;
+		auto dstRow = dst + left + dy * dstW;
+		ImageOps::blend(dstRow, srcRow, right - left, mode, opacity);
 	}
 }
@@ -2,6 +2,7 @@
 #include <blah/streams/filestream.h>
 #include <blah/math/calc.h>
 #include <blah/core/log.h>
+#include <unordered_map>
 
 using namespace Blah;
 
@@ -187,6 +188,220 @@ float Font::get_kerning(int glyph1, int glyph2, float scale) const
 	return stbtt_GetGlyphKernAdvance((stbtt_fontinfo*)m_font, glyph1, glyph2) * scale;
 }
 
+namespace
+{
+	// calls `callback(glyph, coverage_index)` for each glyph in an OpenType Coverage table
+	template<class T>
+	void each_covered(stbtt_uint8* coverage, T callback)
+	{
+		int format = ttUSHORT(coverage);
+
+		if (format == 1)
+		{
+			int count = ttUSHORT(coverage + 2);
+			for (int i = 0; i < count; i++)
+				callback(ttUSHORT(coverage + 4 + i * 2), i);
+		}
+		else if (format == 2)
+		{
+			int count = ttUSHORT(coverage + 2);
+			for (int i = 0; i < count; i++)
+			{
+				auto range = coverage + 4 + i * 6;
+				int start = ttUSHORT(range);
+				int end = ttUSHORT(range + 2);
+				int index = ttUSHORT(range + 4);
+				for (int glyph = start; glyph <= end; glyph++)
+					callback(glyph, index + glyph - start);
+			}
+		}
+	}
+
+	uint64_t pair_key(int glyph1, int glyph2)
+	{
+		return ((uint64_t)glyph1 << 32) | (uint32_t)glyph2;
+	}
+
+	// Reads the pair adjustments out of the GPOS table the same way stbtt_GetGlyphKernAdvance
+	// does: the first pair adjustment subtable that covers a pair decides its value
+	void gpos_kernings(const stbtt_fontinfo* info, const Vector<uint8_t>& included, const Vector<int>& glyphs, std::unordered_map<uint64_t, int>& pairs)
+	{
+		auto data = info->data + info->gpos;
+		if (ttUSHORT(data + 0) != 1 || ttUSHORT(data + 2) != 0)
+			return;
+
+		// first glyphs a subtable has already decided every pair of (until its classes run out)
+		std::unordered_map<int, Vector<stbtt_uint8*>> claimed;
+		Vector<uint8_t> blocked;
+		blocked.resize(included.size());
+
+		auto is_decided = [&](int glyph1, int glyph2)
+		{
+			if (pairs.find(pair_key(glyph1, glyph2)) != pairs.end())
+				return true;
+
+			auto it = claimed.find(glyph1);
+			if (it != claimed.end())
+				for (auto class_def : it->second)
+					if (stbtt__GetGlyphClass(class_def, glyph2) >= 0)
+						return true;
+
+			return false;
+		};
+
+		auto lookup_list = data + ttUSHORT(data + 8);
+		int lookup_count = ttUSHORT(lookup_list);
+
+		for (int i = 0; i < lookup_count; i++)
+		{
+			auto lookup = lookup_list + ttUSHORT(lookup_list + 2 + i * 2);
+			if (ttUSHORT(lookup) != 2)
+				continue;
+
+			int subtable_count = ttUSHORT(lookup + 4);
+			for (int s = 0; s < subtable_count; s++)
+			{
+				auto table = lookup + ttUSHORT(lookup + 6 + s * 2);
+				int format = ttUSHORT(table);
+				auto coverage = table + ttUSHORT(table + 2);
+
+				// stb_truetype only supports x-advance adjustments of the first glyph,
+				// and gives up on any first glyph covered by another kind of subtable
+				bool supported = (ttUSHORT(table + 4) == 4 && ttUSHORT(table + 6) == 0);
+
+				if (format == 1)
+				{
+					each_covered(coverage, [&](int glyph1, int index)
+					{
+						if (glyph1 >= included.size() || !included[glyph1] || blocked[glyph1])
+							return;
+
+						if (!supported)
+						{
+							blocked[glyph1] = 1;
+							return;
+						}
+
+						auto set = table + ttUSHORT(table + 10 + index * 2);
+						int count = ttUSHORT(set);
+						for (int n = 0; n < count; n++)
+						{
+							auto record = set + 2 + n * 4;
+							int glyph2 = ttUSHORT(record);
+							if (glyph2 < included.size() && included[glyph2] && !is_decided(glyph1, glyph2))
+								pairs[pair_key(glyph1, glyph2)] = ttSHORT(record + 2);
+						}
+					});
+				}
+				else if (format == 2)
+				{
+					auto class_def1 = table + ttUSHORT(table + 8);
+					auto class_def2 = table + ttUSHORT(table + 10);
+					int class1_count = ttUSHORT(table + 12);
+					int class2_count = ttUSHORT(table + 14);
+					auto records = table + 16;
+
+					// group the second glyphs by class, so each class row only visits its members
+					Vector<Vector<int>> classes;
+					if (supported)
+					{
+						classes.resize(class2_count);
+						for (auto glyph : glyphs)
+						{
+							int value = stbtt__GetGlyphClass(class_def2, glyph);
+							if (value >= 0 && value < class2_count)
+								classes[value].push_back(glyph);
+						}
+					}
+
+					each_covered(coverage, [&](int glyph1, int)
+					{
+						if (glyph1 >= included.size() || !included[glyph1] || blocked[glyph1])
+							return;
+
+						if (!supported)
+						{
+							blocked[glyph1] = 1;
+							return;
+						}
+
+						int class1 = stbtt__GetGlyphClass(class_def1, glyph1);
+						if (class1 < 0 || class1 >= class1_count)
+							return;
+
+						auto row = records + class1 * class2_count * 2;
+						for (int class2 = 0; class2 < class2_count; class2++)
+						{
+							int value = ttSHORT(row + class2 * 2);
+							if (value == 0)
+								continue;
+
+							for (auto glyph2 : classes[class2])
+								if (!is_decided(glyph1, glyph2))
+									pairs[pair_key(glyph1, glyph2)] = value;
+						}
+
+						claimed[glyph1].push_back(class_def2);
+					});
+				}
+			}
+		}
+	}
+}
+
+Vector<Font::Kerning> Font::get_kernings(const Vector<int>& glyphs, float scale) const
+{
+	Vector<Kerning> result;
+	if (!m_font)
+		return result;
+
+	auto info = (stbtt_fontinfo*)m_font;
+
+	Vector<uint8_t> included;
+	included.resize(info->numGlyphs);
+	for (auto glyph : glyphs)
+		if (glyph >= 0 && glyph < included.size())
+			included[glyph] = 1;
+
+	std::unordered_map<uint64_t, int> pairs;
+
+	if (info->gpos)
+	{
+		gpos_kernings(info, included, glyphs, pairs);
+	}
+	else if (info->kern)
+	{
+		int length = stbtt_GetKerningTableLength(info);
+		if (length > 0)
+		{
+			Vector<stbtt_kerningentry> table;
+			table.resize(length);
+			length = stbtt_GetKerningTable(info, table.data(), length);
+
+			for (int i = 0; i < length; i++)
+			{
+				auto& it = table[i];
+				if (it.glyph1 < included.size() && it.glyph2 < included.size() && included[it.glyph1] && included[it.glyph2])
+					pairs[pair_key(it.glyph1, it.glyph2)] = it.advance;
+			}
+		}
+	}
+
+	for (auto& it : pairs)
+	{
+		if (it.second == 0)
+			continue;
+
+		Kerning kerning;
+		kerning.glyph1 = (int)(it.first >> 32);
+		kerning.glyph2 = (int)(it.first & 0xffffffff);
+		kerning.value = it.second * scale;
+		result.push_back(kerning);
+	}
+
+	return result;
+}
+
 Font::Char Font::get_character(int glyph, float scale) const
 {
 	Char ch;
@@ -217,13 +432,11 @@ Font::Char Font::get_character(int glyph, float scale) const
 
 bool Font::get_image(const Font::Char& ch, Color* pixels) const
 {
-	if (ch.has_glyph)
+	// we actually use the image buffer as our temporary buffer, and fill the pixels out backwards after
+	// kinda weird but it works & saves creating more memory
+	unsigned char* src = (unsigned char*)pixels;
+	if (get_coverage(ch, src))
 	{
-		// we actually use the image buffer as our temporary buffer, and fill the pixels out backwards after
-		// kinda weird but it works & saves creating more memory
-		unsigned char* src = (unsigned char*)pixels;
-		stbtt_MakeGlyphBitmap((stbtt_fontinfo*)m_font, src, ch.width, ch.height, ch.width, ch.scale, ch.scale, ch.glyph);
-
 		int len = ch.width * ch.height;
 		for (int a = (len - 1) * 4, b = (len - 1); b >= 0; a -= 4, b -= 1)
 		{
@@ -239,6 +452,51 @@ bool Font::get_image(const Font::Char& ch, Color* pixels) const
 	return false;
 }
 
+bool Font::get_coverage(const Font::Char& ch, uint8_t* pixels) const
+{
+	if (!ch.has_glyph)
+		return false;
+
+	stbtt_MakeGlyphBitmap((stbtt_fontinfo*)m_font, pixels, ch.width, ch.height, ch.width, ch.scale, ch.scale, ch.glyph);
+	return true;
+}
+
+bool Font::get_sdf_image(const Font::Char& ch, int padding, Color* pixels) const
+{
+	// same trick as get_image, filling the pixels out backwards from the single channel
+	uint8_t* src = (uint8_t*)pixels;
+	if (!get_sdf_coverage(ch, padding, src))
+		return false;
+
+	int len = (ch.width + padding * 2) * (ch.height + padding * 2);
+	for (int i = len - 1; i >= 0; i--)
+		pixels[i] = Color(255, 255, 255, src[i]);
+
+	return true;
+}
+
+bool Font::get_sdf_coverage(const Font::Char& ch, int padding, uint8_t* pixels) const
+{
+	if (!ch.has_glyph || padding <= 0)
+		return false;
+
+	int w, h, x, y;
+	unsigned char* sdf = stbtt_GetGlyphSDF((stbtt_fontinfo*)m_font, ch.scale, ch.glyph, padding, 128, 128.0f / padding, &w, &h, &x, &y);
+	if (sdf == nullptr)
+		return false;
+
+	// the field should match the bitmap box plus the padding, but don't trust it blindly
+	int width = ch.width + padding * 2;
+	int height = ch.height + padding * 2;
+	memset(pixels, 0, width * height);
+
+	for (int py = 0; py < h && py < height; py++)
+		memcpy(pixels + py * width, sdf + py * w, (w < width ? w : width));
+
+	stbtt_FreeSDF(sdf, nullptr);
+	return true;
+}
+
 bool Font::is_valid() const
 {
 	return m_valid;
@@ -1,7 +1,17 @@
 #include <blah/images/image.h>
+#include <blah/images/imageops.h>
 #include <blah/streams/stream.h>
 #include <blah/streams/filestream.h>
 #include <blah/core/log.h>
+#include <blah/math/calc.h>
+#include "../internal/png.h"
+#include "../internal/parallel.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace Blah;
 
@@ -42,6 +52,244 @@ namespace
 	{
 		((Stream*)context)->write((char*)data, size);
 	}
+
+	// QOI, the "Quite OK Image" format: https://qoiformat.org/qoi-specification.pdf
+	// Lossless, a similar size to PNG, and many times faster to encode and decode.
+	constexpr uint8_t qoi_op_index = 0x00;
+	constexpr uint8_t qoi_op_diff = 0x40;
+	constexpr uint8_t qoi_op_luma = 0x80;
+	constexpr uint8_t qoi_op_run = 0xc0;
+	constexpr uint8_t qoi_op_rgb = 0xfe;
+	constexpr uint8_t qoi_op_rgba = 0xff;
+	constexpr uint8_t qoi_mask = 0xc0;
+	constexpr int qoi_header_size = 14;
+	constexpr int qoi_end_size = 8;
+	constexpr int64_t qoi_max_pixels = 400000000;
+
+	bool qoi_is_valid(const uint8_t* data, int64_t length)
+	{
+		return length >= qoi_header_size + qoi_end_size && data[0] == 'q' && data[1] == 'o' && data[2] == 'i' && data[3] == 'f';
+	}
+
+	// plain pixel type, so the hot loops don't call Color's out-of-line constructors and operators
+	struct QoiPixel
+	{
+		uint8_t r, g, b, a;
+	};
+
+	static_assert(sizeof(QoiPixel) == sizeof(Color), "QoiPixel must match the layout of Color");
+
+	bool operator==(QoiPixel lhs, QoiPixel rhs)
+	{
+		return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+	}
+
+	int qoi_hash(QoiPixel c)
+	{
+		return (int)((unsigned)(c.r * 3 + c.g * 5 + c.b * 7 + c.a * 11) % 64);
+	}
+
+	uint32_t qoi_read_u32(const uint8_t* data)
+	{
+		return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+	}
+
+	void qoi_write_u32(uint8_t* data, uint32_t value)
+	{
+		data[0] = (uint8_t)(value >> 24);
+		data[1] = (uint8_t)(value >> 16);
+		data[2] = (uint8_t)(value >> 8);
+		data[3] = (uint8_t)value;
+	}
+
+	// Decodes a QOI image, returning the pixels (allocated with new[]) or nullptr if it's invalid
+	Color* qoi_decode(const uint8_t* data, int64_t length, int* width, int* height)
+	{
+		if (!qoi_is_valid(data, length))
+			return nullptr;
+
+		uint32_t w = qoi_read_u32(data + 4);
+		uint32_t h = qoi_read_u32(data + 8);
+		uint8_t channels = data[12];
+
+		if (w == 0 || h == 0 || (channels != 3 && channels != 4) || (int64_t)w * h > qoi_max_pixels)
+			return nullptr;
+
+		int64_t count = (int64_t)w * h;
+		Color* result = new Color[count];
+		QoiPixel* pixels = (QoiPixel*)result;
+
+		QoiPixel index[64];
+		memset(index, 0, sizeof(index));
+
+		QoiPixel px = { 0, 0, 0, 255 };
+		int64_t p = qoi_header_size;
+		int64_t end = length - qoi_end_size;
+		int64_t i = 0;
+
+		while (i < count && p < end)
+		{
+			uint8_t b1 = data[p++];
+
+			if (b1 == qoi_op_rgb)
+			{
+				if (p + 3 > end)
+					break;
+				px.r = data[p++];
+				px.g = data[p++];
+				px.b = data[p++];
+			}
+			else if (b1 == qoi_op_rgba)
+			{
+				if (p + 4 > end)
+					break;
+				px.r = data[p++];
+				px.g = data[p++];
+				px.b = data[p++];
+				px.a = data[p++];
+			}
+			else if ((b1 & qoi_mask) == qoi_op_index)
+			{
+				px = index[b1];
+			}
+			else if ((b1 & qoi_mask) == qoi_op_diff)
+			{
+				px.r += ((b1 >> 4) & 0x03) - 2;
+				px.g += ((b1 >> 2) & 0x03) - 2;
+				px.b += (b1 & 0x03) - 2;
+			}
+			else if ((b1 & qoi_mask) == qoi_op_luma)
+			{
+				if (p + 1 > end)
+					break;
+				uint8_t b2 = data[p++];
+				int vg = (b1 & 0x3f) - 32;
+				px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+				px.g += vg;
+				px.b += vg - 8 + (b2 & 0x0f);
+			}
+			else
+			{
+				// run of the previous pixel
+				int run = (b1 & 0x3f) + 1;
+				while (run-- > 0 && i < count)
+					pixels[i++] = px;
+				continue;
+			}
+
+			index[qoi_hash(px)] = px;
+			pixels[i++] = px;
+		}
+
+		// truncated data, so fill out the rest with the last pixel
+		while (i < count)
+			pixels[i++] = px;
+
+		*width = (int)w;
+		*height = (int)h;
+		return result;
+	}
+
+	// Encodes the pixels as a 4-channel QOI image
+	bool qoi_encode(Stream& stream, const Color* pixels, int width, int height)
+	{
+		int64_t count = (int64_t)width * height;
+		if (count > qoi_max_pixels)
+			return false;
+
+		// worst case is every pixel written as QOI_OP_RGBA
+		uint8_t* out = new uint8_t[qoi_header_size + count * 5 + qoi_end_size];
+
+		out[0] = 'q'; out[1] = 'o'; out[2] = 'i'; out[3] = 'f';
+		qoi_write_u32(out + 4, (uint32_t)width);
+		qoi_write_u32(out + 8, (uint32_t)height);
+		out[12] = 4;
+		out[13] = 0;
+
+		QoiPixel index[64];
+		memset(index, 0, sizeof(index));
+
+		QoiPixel prev = { 0, 0, 0, 255 };
+		int64_t p = qoi_header_size;
+		int run = 0;
+
+		for (int64_t i = 0; i < count; i++)
+		{
+			QoiPixel px = ((const QoiPixel*)pixels)[i];
+
+			if (px == prev)
+			{
+				run++;
+				if (run == 62 || i == count - 1)
+				{
+					out[p++] = qoi_op_run | (run - 1);
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				out[p++] = qoi_op_run | (run - 1);
+				run = 0;
+			}
+
+			int hash = qoi_hash(px);
+
+			if (index[hash] == px)
+			{
+				out[p++] = qoi_op_index | hash;
+			}
+			else
+			{
+				index[hash] = px;
+
+				if (px.a == prev.a)
+				{
+					int8_t vr = (int8_t)(px.r - prev.r);
+					int8_t vg = (int8_t)(px.g - prev.g);
+					int8_t vb = (int8_t)(px.b - prev.b);
+					int8_t vg_r = (int8_t)(vr - vg);
+					int8_t vg_b = (int8_t)(vb - vg);
+
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+					{
+						out[p++] = qoi_op_diff | (uint8_t)((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+					}
+					else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+					{
+						out[p++] = qoi_op_luma | (uint8_t)(vg + 32);
+						out[p++] = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+					}
+					else
+					{
+						out[p++] = qoi_op_rgb;
+						out[p++] = px.r;
+						out[p++] = px.g;
+						out[p++] = px.b;
+					}
+				}
+				else
+				{
+					out[p++] = qoi_op_rgba;
+					out[p++] = px.r;
+					out[p++] = px.g;
+					out[p++] = px.b;
+					out[p++] = px.a;
+				}
+			}
+
+			prev = px;
+		}
+
+		for (int i = 0; i < qoi_end_size - 1; i++)
+			out[p++] = 0;
+		out[p++] = 1;
+
+		bool result = (stream.write(out, p) == p);
+		delete[] out;
+		return result;
+	}
 }
 
 Image::Image()
@@ -149,6 +397,23 @@ void Image::from_stream(Stream& stream)
 		return;
 	}
 
+	// QOI images are read in full and decoded from memory
+	{
+		int64_t start = stream.position();
+		uint8_t magic[4] = { 0, 0, 0, 0 };
+		stream.read(magic, 4);
+		stream.seek(start);
+
+		if (qoi_is_valid(magic, qoi_header_size + qoi_end_size))
+		{
+			Vector<uint8_t> data;
+			data.resize((int)(stream.length() - start));
+			data.resize((int)stream.read(data.data(), data.size()));
+			from_memory(data.data(), data.size());
+			return;
+		}
+	}
+
 	stbi_io_callbacks callbacks;
 	callbacks.eof = Blah_STBI_Eof;
 	callbacks.read = Blah_STBI_Read;
@@ -169,6 +434,48 @@ void Image::from_stream(Stream& stream)
 	height = y;
 }
 
+void Image::from_memory(const void* data, int64_t length)
+{
+	dispose();
+
+	if (data == nullptr || length <= 0 || length > INT32_MAX)
+	{
+		BLAH_ERROR("Unable to load image as the data was empty or too large");
+		return;
+	}
+
+	int x, y, comps;
+
+	if (qoi_is_valid((const uint8_t*)data, length))
+	{
+		Color* decoded = qoi_decode((const uint8_t*)data, length, &x, &y);
+
+		if (decoded == nullptr)
+		{
+			BLAH_ERROR("Unable to load image as the QOI data was not valid");
+			return;
+		}
+
+		pixels = decoded;
+		width = x;
+		height = y;
+		return;
+	}
+
+	uint8_t* decoded = stbi_load_from_memory((const stbi_uc*)data, (int)length, &x, &y, &comps, 4);
+
+	if (decoded == nullptr)
+	{
+		BLAH_ERROR("Unable to load image as the data was not a valid image");
+		return;
+	}
+
+	m_stbi_ownership = true;
+	pixels = (Color*)decoded;
+	width = x;
+	height = y;
+}
+
 void Image::dispose()
 {
 	if (m_stbi_ownership)
@@ -183,14 +490,7 @@ void Image::dispose()
 void Image::premultiply()
 {
 	if (pixels != nullptr)
-	{
-		for (int n = 0; n < width * height; n ++)
-		{
-			pixels[n].r = (uint8_t)(pixels[n].r * pixels[n].a / 255);
-			pixels[n].g = (uint8_t)(pixels[n].g * pixels[n].a / 255);
-			pixels[n].b = (uint8_t)(pixels[n].b * pixels[n].a / 255);
-		}
-	}
+		ImageOps::premultiply(pixels, (int64_t)width * height);
 }
 
 void Image::set_pixels(const RectI& rect, Color* data)
@@ -216,13 +516,36 @@ bool Image::save_png(Stream& stream) const
 	
 	if (stream.is_writable())
 	{
-		stbi_write_force_png_filter = 0;
-		stbi_write_png_compression_level = 0;
+		if (Png::encode(stream, pixels, width, height))
+			return true;
+		else
+			Log::error("Failed to write PNG image");
+	}
+	else
+	{
+		Log::error("Cannot save Image, the Stream is not writable");
+	}
 
-		if (stbi_write_png_to_func(Blah_STBI_Write, &stream, width, height, 4, pixels, width * 4) != 0)
+	return false;
+}
+
+bool Image::save_qoi(const char* file) const
+{
+	FileStream fs(file, FileMode::Write);
+	return save_qoi(fs);
+}
+
+bool Image::save_qoi(Stream& stream) const
+{
+	BLAH_ASSERT(pixels != nullptr, "Image Pixel data cannot be null");
+	BLAH_ASSERT(width > 0 && height > 0, "Image Width and Height must be larger than 0");
+
+	if (stream.is_writable())
+	{
+		if (qoi_encode(stream, pixels, width, height))
 			return true;
 		else
-			Log::error("stbi_write_png_to_func failed");
+			Log::error("Failed to write QOI image");
 	}
 	else
 	{
@@ -299,3 +622,299 @@ Image Image::get_sub_image(const RectI& sourceRect)
 	get_pixels(img.pixels, Point::zero, Point(img.width, img.height), sourceRect);
 	return img;
 }
+
+namespace
+{
+	// A source pixel, and how much it contributes to a destination pixel
+	struct Tap
+	{
+		int index;
+		float weight;
+	};
+
+	// The taps of every destination pixel along one axis.
+	// Pixel `i` uses taps [offsets[i], offsets[i + 1]).
+	struct Taps
+	{
+		Vector<int> offsets;
+		Vector<Tap> taps;
+	};
+
+	float filter_support(ImageFilter filter)
+	{
+		switch (filter)
+		{
+		case ImageFilter::Box: return 0.5f;
+		case ImageFilter::Bilinear: return 1.0f;
+		case ImageFilter::Lanczos3: return 3.0f;
+		}
+
+		return 1.0f;
+	}
+
+	float filter_weight(ImageFilter filter, float x)
+	{
+		x = (x < 0 ? -x : x);
+
+		switch (filter)
+		{
+		case ImageFilter::Box:
+			return x <= 0.5f ? 1.0f : 0.0f;
+
+		case ImageFilter::Bilinear:
+			return x < 1.0f ? 1.0f - x : 0.0f;
+
+		case ImageFilter::Lanczos3:
+			if (x < 1e-6f)
+				return 1.0f;
+			if (x >= 3.0f)
+				return 0.0f;
+			{
+				float pix = x * Calc::PI;
+				return 3.0f * sinf(pix) * sinf(pix / 3.0f) / (pix * pix);
+			}
+		}
+
+		return 0.0f;
+	}
+
+	Taps calc_taps(int src_size, int dst_size, ImageFilter filter)
+	{
+		Taps result;
+
+		// when downscaling the filter is stretched to cover every source pixel
+		float scale = (float)src_size / dst_size;
+		float stretch = (scale > 1.0f ? scale : 1.0f);
+		float support = filter_support(filter) * stretch;
+
+		result.offsets.push_back(0);
+
+		for (int i = 0; i < dst_size; i++)
+		{
+			float center = (i + 0.5f) * scale;
+			int first = (int)floorf(center - support);
+			int last = (int)ceilf(center + support);
+			int start = result.taps.size();
+			float total = 0;
+
+			for (int j = first; j <= last; j++)
+			{
+				float weight = filter_weight(filter, (j + 0.5f - center) / stretch);
+				if (weight == 0)
+					continue;
+
+				Tap tap;
+				tap.index = Calc::clamp_int(j, 0, src_size - 1);
+				tap.weight = weight;
+				result.taps.push_back(tap);
+				total += weight;
+			}
+
+			if (total != 0)
+				for (int j = start; j < result.taps.size(); j++)
+					result.taps[j].weight /= total;
+
+			result.offsets.push_back(result.taps.size());
+		}
+
+		return result;
+	}
+
+	// accumulates `weight * src` into `dst`, for `count` floats
+	inline void accumulate(float* dst, const float* src, float weight, int count)
+	{
+		int i = 0;
+
+#ifdef IMAGE_SSE2
+		__m128 w = _mm_set1_ps(weight);
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+#endif
+
+		for (; i < count; i++)
+			dst[i] += weight * src[i];
+	}
+
+	// splits `count` rows into jobs of a few rows each, for Parallel::for_each
+	int rows_per_job(int count)
+	{
+		int jobs = Parallel::thread_count() * 4;
+		int rows = (count + jobs - 1) / jobs;
+		return (rows > 0 ? rows : 1);
+	}
+
+	// sRGB conversion tables for mip generation
+	struct SrgbTables
+	{
+		float to_linear[256];
+		uint8_t to_srgb[4096];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				to_linear[i] = (c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f));
+			}
+
+			for (int i = 0; i < 4096; i++)
+			{
+				float c = i / 4095.0f;
+				float s = (c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f);
+				to_srgb[i] = (uint8_t)(s * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables& srgb_tables()
+	{
+		static SrgbTables instance;
+		return instance;
+	}
+
+	Color average(const Color& a, const Color& b, const Color& c, const Color& d, bool srgb, bool premultiplied)
+	{
+		const Color* px[4] = { &a, &b, &c, &d };
+		int alpha = a.a + b.a + c.a + d.a;
+		bool weighted = (!premultiplied && alpha > 0);
+		Color result;
+		result.a = (uint8_t)((alpha + 2) / 4);
+
+		if (!srgb)
+		{
+			int total = (weighted ? alpha : 4);
+			for (int ch = 0; ch < 3; ch++)
+			{
+				int sum = 0;
+				for (int i = 0; i < 4; i++)
+					sum += (&px[i]->r)[ch] * (weighted ? px[i]->a : 1);
+				(&result.r)[ch] = (uint8_t)((sum + total / 2) / total);
+			}
+		}
+		else
+		{
+			auto& tables = srgb_tables();
+			float total = (weighted ? (float)alpha : 4.0f);
+			for (int ch = 0; ch < 3; ch++)
+			{
+				float sum = 0;
+				for (int i = 0; i < 4; i++)
+					sum += tables.to_linear[(&px[i]->r)[ch]] * (weighted ? px[i]->a : 1);
+				(&result.r)[ch] = tables.to_srgb[(int)(sum / total * 4095.0f + 0.5f)];
+			}
+		}
+
+		return result;
+	}
+}
+
+Image Image::resize(int new_width, int new_height, ImageFilter filter) const
+{
+	BLAH_ASSERT(new_width > 0 && new_height > 0, "Image width and height must be larger than 0");
+
+	Image result(new_width, new_height);
+	if (pixels == nullptr || width <= 0 || height <= 0)
+		return result;
+
+	Taps horizontal = calc_taps(width, new_width, filter);
+	Taps vertical = calc_taps(height, new_height, filter);
+
+	// horizontal pass, into premultiplied floats
+	Vector<float> scaled;
+	scaled.resize(new_width * height * 4);
+
+	int rows = rows_per_job(height);
+	Parallel::for_each((height + rows - 1) / rows, [&](int job)
+	{
+		Vector<float> source;
+		source.resize(width * 4);
+
+		for (int y = job * rows; y < height && y < (job + 1) * rows; y++)
+		{
+			const Color* from = pixels + (int64_t)y * width;
+			for (int x = 0; x < width; x++)
+			{
+				float alpha = from[x].a / 255.0f;
+				source[x * 4 + 0] = from[x].r * alpha;
+				source[x * 4 + 1] = from[x].g * alpha;
+				source[x * 4 + 2] = from[x].b * alpha;
+				source[x * 4 + 3] = from[x].a;
+			}
+
+			float* to = scaled.data() + (int64_t)y * new_width * 4;
+			memset(to, 0, sizeof(float) * new_width * 4);
+
+			for (int x = 0; x < new_width; x++)
+				for (int t = horizontal.offsets[x]; t < horizontal.offsets[x + 1]; t++)
+					accumulate(to + x * 4, source.data() + horizontal.taps[t].index * 4, horizontal.taps[t].weight, 4);
+		}
+	});
+
+	// vertical pass, back into colors
+	rows = rows_per_job(new_height);
+	Parallel::for_each((new_height + rows - 1) / rows, [&](int job)
+	{
+		Vector<float> sum;
+		sum.resize(new_width * 4);
+
+		for (int y = job * rows; y < new_height && y < (job + 1) * rows; y++)
+		{
+			memset(sum.data(), 0, sizeof(float) * sum.size());
+
+			for (int t = vertical.offsets[y]; t < vertical.offsets[y + 1]; t++)
+				accumulate(sum.data(), scaled.data() + (int64_t)vertical.taps[t].index * new_width * 4, vertical.taps[t].weight, new_width * 4);
+
+			Color* to = result.pixels + (int64_t)y * new_width;
+			for (int x = 0; x < new_width; x++)
+			{
+				// lanczos can overshoot, so everything is clamped
+				float alpha = Calc::clamp(sum[x * 4 + 3], 0.0f, 255.0f);
+				float scale = (alpha > 0 ? 255.0f / alpha : 0.0f);
+
+				to[x].r = (uint8_t)(Calc::clamp(sum[x * 4 + 0] * scale, 0.0f, 255.0f) + 0.5f);
+				to[x].g = (uint8_t)(Calc::clamp(sum[x * 4 + 1] * scale, 0.0f, 255.0f) + 0.5f);
+				to[x].b = (uint8_t)(Calc::clamp(sum[x * 4 + 2] * scale, 0.0f, 255.0f) + 0.5f);
+				to[x].a = (uint8_t)(alpha + 0.5f);
+			}
+		}
+	});
+
+	return result;
+}
+
+Vector<Image> Image::build_mips(bool srgb, bool premultiplied) const
+{
+	Vector<Image> mips;
+	if (pixels == nullptr || width <= 0 || height <= 0)
+		return mips;
+
+	const Image* source = this;
+
+	while (source->width > 1 || source->height > 1)
+	{
+		Image mip(Calc::max(1, source->width / 2), Calc::max(1, source->height / 2));
+
+		int rows = rows_per_job(mip.height);
+		Parallel::for_each((mip.height + rows - 1) / rows, [&](int job)
+		{
+			for (int y = job * rows; y < mip.height && y < (job + 1) * rows; y++)
+			{
+				const Color* top = source->pixels + (int64_t)Calc::min(y * 2, source->height - 1) * source->width;
+				const Color* bottom = source->pixels + (int64_t)Calc::min(y * 2 + 1, source->height - 1) * source->width;
+				Color* to = mip.pixels + (int64_t)y * mip.width;
+
+				for (int x = 0; x < mip.width; x++)
+				{
+					int x0 = Calc::min(x * 2, source->width - 1);
+					int x1 = Calc::min(x * 2 + 1, source->width - 1);
+					to[x] = average(top[x0], top[x1], bottom[x0], bottom[x1], srgb, premultiplied);
+				}
+			}
+		});
+
+		mips.push_back(std::move(mip));
+		source = &mips.back();
+	}
+
+	return mips;
+}
@@ -0,0 +1,239 @@
+#include <blah/images/imageloader.h>
+#include <blah/streams/filestream.h>
+#include <blah/core/log.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define BLAH_IMAGELOADER_SYNC
+#endif
+
+using namespace Blah;
+
+namespace
+{
+	struct Job
+	{
+		FilePath path;
+		Vector<char> data;
+		std::promise<Image> promise;
+		ImageLoader::Callback callback;
+	};
+
+	Image decode(Job& job)
+	{
+		Image image;
+
+		// read the whole file at once, so the decoder works from memory
+		if (job.data.size() <= 0 && job.path.length() > 0)
+		{
+			FileStream fs(job.path.cstr(), FileMode::Read);
+
+			if (fs.is_readable())
+			{
+				job.data.resize((int)fs.length());
+				if (fs.read(job.data.data(), job.data.size()) != job.data.size())
+					job.data.clear();
+			}
+
+			if (job.data.size() <= 0)
+				Log::error("Unable to read image file %s", job.path.cstr());
+		}
+
+		if (job.data.size() > 0)
+			image.from_memory(job.data.data(), job.data.size());
+
+		job.data.dispose();
+		return image;
+	}
+
+	// the pool the current thread works for, if any
+	thread_local const void* current_pool = nullptr;
+
+	void deliver(Job& job, Image& image)
+	{
+		if (job.callback)
+			job.callback(job.path, image);
+		else
+			job.promise.set_value(std::move(image));
+	}
+}
+
+struct ImageLoader::Pool
+{
+	std::vector<std::thread> workers;
+	std::deque<Job> queue;
+	std::mutex mutex;
+	std::condition_variable work;
+	std::condition_variable finished;
+
+	// jobs holding encoded data, which is capped
+	int in_flight = 0;
+	int max_in_flight = 0;
+
+	// jobs that haven't been delivered yet
+	int pending = 0;
+	bool stopping = false;
+
+	void run()
+	{
+		current_pool = this;
+
+		while (true)
+		{
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work.wait(lock, [&]() { return stopping || queue.size() > 0; });
+				if (queue.size() <= 0)
+					return;
+
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			Image image = decode(job);
+
+			// the encoded data is gone, so another job can be queued
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				in_flight--;
+			}
+			finished.notify_all();
+
+			deliver(job, image);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending--;
+			}
+			finished.notify_all();
+		}
+	}
+
+	void push(Job&& job)
+	{
+		// jobs queued from a callback run right away, as waiting for a free slot
+		// could block every worker on slots that only the workers can free
+		if (workers.size() <= 0 || current_pool == this)
+		{
+			Image image = decode(job);
+			deliver(job, image);
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			finished.wait(lock, [&]() { return in_flight < max_in_flight; });
+			in_flight++;
+			pending++;
+			queue.push_back(std::move(job));
+		}
+
+		work.notify_one();
+	}
+};
+
+ImageLoader::ImageLoader(int threads, int max_in_flight)
+{
+	m_pool = new Pool();
+
+#ifndef BLAH_IMAGELOADER_SYNC
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+
+	for (int i = 0; i < threads; i++)
+		m_pool->workers.emplace_back([pool = m_pool]() { pool->run(); });
+#endif
+
+	m_pool->max_in_flight = (max_in_flight > 0 ? max_in_flight : (int)m_pool->workers.size() * 2);
+}
+
+ImageLoader::~ImageLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_pool->mutex);
+		m_pool->stopping = true;
+	}
+
+	// the workers finish the queue before stopping
+	m_pool->work.notify_all();
+	for (auto& it : m_pool->workers)
+		it.join();
+
+	delete m_pool;
+}
+
+std::future<Image> ImageLoader::load(const FilePath& path)
+{
+	Job job;
+	job.path = path;
+
+	auto future = job.promise.get_future();
+	m_pool->push(std::move(job));
+	return future;
+}
+
+void ImageLoader::load(const FilePath& path, const Callback& on_loaded)
+{
+	Job job;
+	job.path = path;
+	job.callback = on_loaded;
+	m_pool->push(std::move(job));
+}
+
+std::future<Image> ImageLoader::load(Stream& stream)
+{
+	Job job;
+
+	if (stream.is_readable())
+	{
+		job.data.resize((int)(stream.length() - stream.position()));
+		if (stream.read(job.data.data(), job.data.size()) != job.data.size())
+			job.data.clear();
+	}
+
+	if (job.data.size() <= 0)
+		Log::error("Unable to load image as the Stream was not readable");
+
+	auto future = job.promise.get_future();
+	m_pool->push(std::move(job));
+	return future;
+}
+
+Vector<Image> ImageLoader::load_all(const Vector<FilePath>& paths)
+{
+	Vector<std::future<Image>> futures;
+	for (auto& it : paths)
+		futures.push_back(load(it));
+
+	Vector<Image> images;
+	for (auto& it : futures)
+		images.push_back(it.get());
+
+	return images;
+}
+
+void ImageLoader::wait()
+{
+	// the callback's own job is still pending, so this would never return
+	if (current_pool == m_pool)
+	{
+		BLAH_ERROR("ImageLoader::wait can't be called from one of its callbacks");
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_pool->mutex);
+	m_pool->finished.wait(lock, [&]() { return m_pool->pending <= 0; });
+}
+
+int ImageLoader::thread_count() const
+{
+	return m_pool->workers.size();
+}
@@ -0,0 +1,894 @@
+#include <blah/images/imageops.h>
+#include <string.h>
+#include <math.h>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGEOPS_SSE2
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define IMAGEOPS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Blah;
+
+namespace
+{
+	// exact `v / 255` for v in [0, 255 * 255], without the divide
+	inline uint8_t div_255(int v)
+	{
+		return (uint8_t)((v + 1 + (v >> 8)) >> 8);
+	}
+
+	// rounded `a * b / 255`, the same as Aseprite's MUL_UN8
+	inline int mul_un8(int a, int b)
+	{
+		int t = a * b + 0x80;
+		return ((t >> 8) + t) >> 8;
+	}
+
+	inline void premultiply_pixel(Color* it)
+	{
+		it->r = div_255(it->r * it->a);
+		it->g = div_255(it->g * it->a);
+		it->b = div_255(it->b * it->a);
+	}
+
+	inline void unpremultiply_pixel(Color* it)
+	{
+		int a = it->a;
+		if (a == 0)
+			return;
+
+		int r = (it->r * 255 + a / 2) / a;
+		int g = (it->g * 255 + a / 2) / a;
+		int b = (it->b * 255 + a / 2) / a;
+		it->r = (uint8_t)(r > 255 ? 255 : r);
+		it->g = (uint8_t)(g > 255 ? 255 : g);
+		it->b = (uint8_t)(b > 255 ? 255 : b);
+	}
+
+	inline void source_over_pixel(Color* d, const Color* s, int opacity)
+	{
+		int sa = mul_un8(s->a, opacity);
+		if (sa == 0)
+			return;
+
+		int ra = d->a + sa - mul_un8(d->a, sa);
+		d->r = (uint8_t)(d->r + (s->r - d->r) * sa / ra);
+		d->g = (uint8_t)(d->g + (s->g - d->g) * sa / ra);
+		d->b = (uint8_t)(d->b + (s->b - d->b) * sa / ra);
+		d->a = (uint8_t)ra;
+	}
+
+	// returns the first pixel in [from, to) with an Alpha above 0, or -1
+	int first_visible(const Color* row, int from, int to)
+	{
+		int x = from;
+
+#if defined(IMAGEOPS_SSE2)
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 4 <= to; x += 4)
+		{
+			__m128i px = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x)), alpha);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(px, zero)) != 0xffff)
+				break;
+		}
+#elif defined(IMAGEOPS_NEON)
+		for (; x + 4 <= to; x += 4)
+		{
+			uint32x4_t px = vandq_u32(vld1q_u32((const uint32_t*)(row + x)), vdupq_n_u32(0xff000000));
+			if (vmaxvq_u32(px) != 0)
+				break;
+		}
+#endif
+
+		for (; x < to; x++)
+			if (row[x].a > 0)
+				return x;
+
+		return -1;
+	}
+
+	// returns the last pixel in [from, to) with an Alpha above 0, or -1
+	int last_visible(const Color* row, int from, int to)
+	{
+		int x = to;
+
+#if defined(IMAGEOPS_SSE2)
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		const __m128i zero = _mm_setzero_si128();
+		for (; x - 4 >= from; x -= 4)
+		{
+			__m128i px = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x - 4)), alpha);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(px, zero)) != 0xffff)
+				break;
+		}
+#elif defined(IMAGEOPS_NEON)
+		for (; x - 4 >= from; x -= 4)
+		{
+			uint32x4_t px = vandq_u32(vld1q_u32((const uint32_t*)(row + x - 4)), vdupq_n_u32(0xff000000));
+			if (vmaxvq_u32(px) != 0)
+				break;
+		}
+#endif
+
+		for (x--; x >= from; x--)
+			if (row[x].a > 0)
+				return x;
+
+		return -1;
+	}
+}
+
+void ImageOps::premultiply(Color* pixels, int64_t count)
+{
+	int64_t i = 0;
+
+#if defined(IMAGEOPS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i px = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i lo = _mm_unpacklo_epi8(px, zero);
+		__m128i hi = _mm_unpackhi_epi8(px, zero);
+
+		__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+		__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+
+		// (v + 1 + (v >> 8)) >> 8
+		__m128i mlo = _mm_mullo_epi16(lo, alo);
+		__m128i mhi = _mm_mullo_epi16(hi, ahi);
+		mlo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(mlo, one), _mm_srli_epi16(mlo, 8)), 8);
+		mhi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(mhi, one), _mm_srli_epi16(mhi, 8)), 8);
+
+		__m128i result = _mm_packus_epi16(mlo, mhi);
+		result = _mm_or_si128(_mm_andnot_si128(alpha, result), _mm_and_si128(alpha, px));
+		_mm_storeu_si128((__m128i*)(pixels + i), result);
+	}
+#elif defined(IMAGEOPS_NEON)
+	const uint16x8_t one = vdupq_n_u16(1);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t px = vld4_u8((const uint8_t*)(pixels + i));
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint16x8_t m = vmull_u8(px.val[c], px.val[3]);
+			px.val[c] = vshrn_n_u16(vaddq_u16(vaddq_u16(m, one), vshrq_n_u16(m, 8)), 8);
+		}
+
+		vst4_u8((uint8_t*)(pixels + i), px);
+	}
+#endif
+
+	for (; i < count; i++)
+		premultiply_pixel(pixels + i);
+}
+
+void ImageOps::unpremultiply(Color* pixels, int64_t count)
+{
+	int64_t i = 0;
+
+	// The float divide is exact here: numerators stay below 2^24, so truncating
+	// the quotient gives the same result as the integer divide.
+#if defined(IMAGEOPS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 min_alpha = _mm_set1_ps(1.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i px = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i lo = _mm_unpacklo_epi8(px, zero);
+		__m128i hi = _mm_unpackhi_epi8(px, zero);
+
+		// one pixel per register, one channel per lane
+		__m128i channels[4] = {
+			_mm_unpacklo_epi16(lo, zero),
+			_mm_unpackhi_epi16(lo, zero),
+			_mm_unpacklo_epi16(hi, zero),
+			_mm_unpackhi_epi16(hi, zero)
+		};
+
+		for (int p = 0; p < 4; p++)
+		{
+			__m128i a = _mm_shuffle_epi32(channels[p], 0xff);
+			__m128 af = _mm_max_ps(_mm_cvtepi32_ps(a), min_alpha);
+			__m128 num = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(channels[p]), scale), _mm_cvtepi32_ps(_mm_srli_epi32(a, 1)));
+			channels[p] = _mm_cvttps_epi32(_mm_div_ps(num, af));
+		}
+
+		// saturating packs clamp to 255
+		__m128i result = _mm_packus_epi16(
+			_mm_packs_epi32(channels[0], channels[1]),
+			_mm_packs_epi32(channels[2], channels[3]));
+
+		// keep the original alpha, and leave fully transparent pixels alone
+		result = _mm_or_si128(_mm_andnot_si128(alpha, result), _mm_and_si128(alpha, px));
+		__m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(px, alpha), zero);
+		result = _mm_or_si128(_mm_and_si128(transparent, px), _mm_andnot_si128(transparent, result));
+
+		_mm_storeu_si128((__m128i*)(pixels + i), result);
+	}
+#elif defined(IMAGEOPS_NEON)
+	const float32x4_t scale = vdupq_n_f32(255.0f);
+	const float32x4_t min_alpha = vdupq_n_f32(1.0f);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t px = vld4_u8((const uint8_t*)(pixels + i));
+		uint16x8_t a = vmovl_u8(px.val[3]);
+		uint16x8_t half = vshrq_n_u16(a, 1);
+		float32x4_t alo = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(a))), min_alpha);
+		float32x4_t ahi = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(a))), min_alpha);
+		float32x4_t hlo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(half)));
+		float32x4_t hhi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(half)));
+		uint8x8_t transparent = vceq_u8(px.val[3], vdup_n_u8(0));
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint16x8_t v = vmovl_u8(px.val[c]);
+			float32x4_t nlo = vaddq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale), hlo);
+			float32x4_t nhi = vaddq_f32(vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale), hhi);
+			uint32x4_t qlo = vcvtq_u32_f32(vdivq_f32(nlo, alo));
+			uint32x4_t qhi = vcvtq_u32_f32(vdivq_f32(nhi, ahi));
+			uint8x8_t result = vqmovn_u16(vcombine_u16(vqmovn_u32(qlo), vqmovn_u32(qhi)));
+			px.val[c] = vbsl_u8(transparent, px.val[c], result);
+		}
+
+		vst4_u8((uint8_t*)(pixels + i), px);
+	}
+#endif
+
+	for (; i < count; i++)
+		unpremultiply_pixel(pixels + i);
+}
+
+void ImageOps::swizzle_rb(Color* pixels, int64_t count)
+{
+	int64_t i = 0;
+
+#if defined(IMAGEOPS_SSE2)
+	const __m128i ga = _mm_set1_epi32((int)0xff00ff00);
+	const __m128i low = _mm_set1_epi32(0x000000ff);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i px = _mm_loadu_si128((const __m128i*)(pixels + i));
+		__m128i r = _mm_slli_epi32(_mm_and_si128(px, low), 16);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(px, 16), low);
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_or_si128(_mm_and_si128(px, ga), _mm_or_si128(r, b)));
+	}
+#elif defined(IMAGEOPS_NEON)
+	for (; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t px = vld4_u8((const uint8_t*)(pixels + i));
+		uint8x8_t r = px.val[0];
+		px.val[0] = px.val[2];
+		px.val[2] = r;
+		vst4_u8((uint8_t*)(pixels + i), px);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		uint8_t r = pixels[i].r;
+		pixels[i].r = pixels[i].b;
+		pixels[i].b = r;
+	}
+}
+
+void ImageOps::gray_to_rgba(const uint8_t* src, Color* dst, int64_t count)
+{
+	// work backwards, so the expansion can happen in-place.
+	// each block is fully read before it's written, and never writes over unread source bytes.
+	int64_t i = count;
+
+#if defined(IMAGEOPS_SSE2)
+	const __m128i low = _mm_set1_epi16(0x00ff);
+
+	for (; i >= 8; i -= 8)
+	{
+		// 8 pixels of (gray, alpha)
+		__m128i px = _mm_loadu_si128((const __m128i*)(src + (i - 8) * 2));
+		__m128i g = _mm_and_si128(px, low);
+		__m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+
+		// (gray, gray) + (gray, alpha) = (gray, gray, gray, alpha)
+		__m128i lo = _mm_unpacklo_epi16(gg, px);
+		__m128i hi = _mm_unpackhi_epi16(gg, px);
+		_mm_storeu_si128((__m128i*)(dst + i - 8), lo);
+		_mm_storeu_si128((__m128i*)(dst + i - 4), hi);
+	}
+#elif defined(IMAGEOPS_NEON)
+	for (; i >= 8; i -= 8)
+	{
+		uint8x8x2_t px = vld2_u8(src + (i - 8) * 2);
+		uint8x8x4_t result;
+		result.val[0] = px.val[0];
+		result.val[1] = px.val[0];
+		result.val[2] = px.val[0];
+		result.val[3] = px.val[1];
+		vst4_u8((uint8_t*)(dst + i - 8), result);
+	}
+#endif
+
+	for (i--; i >= 0; i--)
+	{
+		uint8_t g = src[i * 2];
+		uint8_t a = src[i * 2 + 1];
+		dst[i] = Color(g, g, g, a);
+	}
+}
+
+void ImageOps::indexed_to_rgba(const uint8_t* src, Color* dst, int64_t count, const Color* palette, int palette_count)
+{
+	// a full 256 entry table avoids a bounds check per pixel
+	Color table[256];
+	for (int n = 0; n < 256; n++)
+		table[n] = (n < palette_count ? palette[n] : Color(0, 0, 0, 0));
+
+	// work backwards, so the expansion can happen in-place
+	int64_t i = count - 1;
+	for (; i >= 3; i -= 4)
+	{
+		uint8_t i0 = src[i - 3], i1 = src[i - 2], i2 = src[i - 1], i3 = src[i];
+		dst[i] = table[i3];
+		dst[i - 1] = table[i2];
+		dst[i - 2] = table[i1];
+		dst[i - 3] = table[i0];
+	}
+
+	for (; i >= 0; i--)
+		dst[i] = table[src[i]];
+}
+
+void ImageOps::flip_vertically(Color* pixels, int width, int height)
+{
+	constexpr int chunk = 256;
+	Color temp[chunk];
+
+	for (int y = 0; y < height / 2; y++)
+	{
+		Color* a = pixels + (int64_t)y * width;
+		Color* b = pixels + (int64_t)(height - 1 - y) * width;
+
+		for (int x = 0; x < width; x += chunk)
+		{
+			int length = (width - x < chunk ? width - x : chunk);
+			memcpy(temp, a + x, sizeof(Color) * length);
+			memcpy(a + x, b + x, sizeof(Color) * length);
+			memcpy(b + x, temp, sizeof(Color) * length);
+		}
+	}
+}
+
+bool ImageOps::alpha_bounds(const Color* pixels, int width, int height, RectI* bounds)
+{
+	int top = 0, bottom = height - 1;
+	int left = -1, right = -1;
+
+	// top
+	for (; top < height; top++)
+	{
+		left = first_visible(pixels + (int64_t)top * width, 0, width);
+		if (left >= 0)
+			break;
+	}
+
+	if (left < 0)
+		return false;
+
+	right = last_visible(pixels + (int64_t)top * width, left, width);
+
+	// bottom
+	for (; bottom > top; bottom--)
+		if (first_visible(pixels + (int64_t)bottom * width, 0, width) >= 0)
+			break;
+
+	// left & right, only scanning the parts of each row outside what we've already found
+	for (int y = top; y <= bottom; y++)
+	{
+		auto row = pixels + (int64_t)y * width;
+
+		int l = first_visible(row, 0, left);
+		if (l >= 0)
+			left = l;
+
+		int r = last_visible(row, right + 1, width);
+		if (r >= 0)
+			right = r;
+	}
+
+	if (bounds != nullptr)
+		*bounds = RectI(left, top, right - left + 1, bottom - top + 1);
+
+	return true;
+}
+
+void ImageOps::blend_source_over(Color* dst, const Color* src, int64_t count, uint8_t opacity)
+{
+	int64_t i = 0;
+
+	// The divide by the resulting alpha is done in float: the numerators stay below 2^24,
+	// so truncating the quotient gives the same result as the scalar integer divide.
+#if defined(IMAGEOPS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(0x80);
+	const __m128i op = _mm_set1_epi16(opacity);
+	const __m128i alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	const __m128 min_alpha = _mm_set1_ps(1.0f);
+
+	auto mul_un8_epi16 = [&](__m128i a, __m128i b)
+	{
+		__m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), round);
+		return _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(t, 8), t), 8);
+	};
+
+	// blends two pixels, unpacked to 16 bits per channel
+	auto blend = [&](__m128i s, __m128i d)
+	{
+		__m128i sa = mul_un8_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff), op);
+		__m128i da = _mm_shufflehi_epi16(_mm_shufflelo_epi16(d, 0xff), 0xff);
+		__m128i ra = _mm_sub_epi16(_mm_add_epi16(da, sa), mul_un8_epi16(da, sa));
+
+		// (s - d) * sa, widened to 32 bits
+		__m128i diff = _mm_sub_epi16(s, d);
+		__m128i plo = _mm_mullo_epi16(diff, sa);
+		__m128i phi = _mm_mulhi_epi16(diff, sa);
+		__m128i p0 = _mm_unpacklo_epi16(plo, phi);
+		__m128i p1 = _mm_unpackhi_epi16(plo, phi);
+
+		__m128 ra0 = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(ra, zero)), min_alpha);
+		__m128 ra1 = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(ra, zero)), min_alpha);
+		__m128i q0 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(p0), ra0));
+		__m128i q1 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(p1), ra1));
+
+		__m128i result = _mm_add_epi16(d, _mm_packs_epi32(q0, q1));
+		result = _mm_or_si128(_mm_andnot_si128(alpha, result), _mm_and_si128(alpha, ra));
+
+		// pixels with no source alpha are left untouched
+		__m128i skip = _mm_cmpeq_epi16(sa, zero);
+		return _mm_or_si128(_mm_and_si128(skip, d), _mm_andnot_si128(skip, result));
+	};
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+
+		// skip fully transparent source runs entirely
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero)) == 0xffff)
+			continue;
+
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i lo = blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		__m128i hi = blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(IMAGEOPS_NEON)
+	const uint8x8_t op = vdup_n_u8(opacity);
+	const uint16x8_t round = vdupq_n_u16(0x80);
+	const float32x4_t min_alpha = vdupq_n_f32(1.0f);
+
+	auto mul_un8_u8 = [&](uint8x8_t a, uint8x8_t b)
+	{
+		uint16x8_t t = vaddq_u16(vmull_u8(a, b), round);
+		return vshrn_n_u16(vaddq_u16(vshrq_n_u16(t, 8), t), 8);
+	};
+
+	for (; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t s = vld4_u8((const uint8_t*)(src + i));
+		if (vmaxv_u8(s.val[3]) == 0)
+			continue;
+
+		uint8x8x4_t d = vld4_u8((const uint8_t*)(dst + i));
+		uint8x8_t sa = mul_un8_u8(s.val[3], op);
+		uint16x8_t ra = vsubq_u16(vaddl_u8(d.val[3], sa), vmovl_u8(mul_un8_u8(d.val[3], sa)));
+		float32x4_t ralo = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(ra))), min_alpha);
+		float32x4_t rahi = vmaxq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(ra))), min_alpha);
+		int16x8_t sa16 = vreinterpretq_s16_u16(vmovl_u8(sa));
+		uint8x8_t skip = vceq_u8(sa, vdup_n_u8(0));
+
+		for (int c = 0; c < 3; c++)
+		{
+			int16x8_t dc = vreinterpretq_s16_u16(vmovl_u8(d.val[c]));
+			int16x8_t diff = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(s.val[c])), dc);
+			int32x4_t plo = vmull_s16(vget_low_s16(diff), vget_low_s16(sa16));
+			int32x4_t phi = vmull_s16(vget_high_s16(diff), vget_high_s16(sa16));
+			int32x4_t qlo = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(plo), ralo));
+			int32x4_t qhi = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(phi), rahi));
+			int16x8_t result = vaddq_s16(dc, vcombine_s16(vmovn_s32(qlo), vmovn_s32(qhi)));
+			d.val[c] = vbsl_u8(skip, d.val[c], vqmovun_s16(result));
+		}
+
+		d.val[3] = vbsl_u8(skip, d.val[3], vmovn_u16(ra));
+		vst4_u8((uint8_t*)(dst + i), d);
+	}
+#endif
+
+	for (; i < count; i++)
+		source_over_pixel(dst + i, src + i, opacity);
+}
+
+namespace
+{
+	using ImageOps::Blend;
+
+	// rounded `a * 255 / b`, the same as Aseprite's DIV_UN8
+	inline int div_un8(int a, int b)
+	{
+		return (a * 255 + b / 2) / b;
+	}
+
+	// rounded `(s * (255 - a) + b * a) / 255`
+	inline int mix_un8(int s, int b, int a)
+	{
+		int t = s * (255 - a) + b * a + 0x80;
+		return ((t >> 8) + t) >> 8;
+	}
+
+	inline int soft_light(int backdrop, int source)
+	{
+		float b = backdrop / 255.0f;
+		float s = source / 255.0f;
+		float d = (b <= 0.25f ? ((16.0f * b - 12.0f) * b + 4.0f) * b : sqrtf(b));
+		float r = (s <= 0.5f ? b - (1.0f - 2.0f * s) * b * (1.0f - b) : b + (2.0f * s - 1.0f) * (d - b));
+		return (int)(r * 255.0f + 0.5f);
+	}
+
+	// blends one channel of the backdrop `b` with the source `s`
+	template<Blend mode>
+	inline int blend_channel(int b, int s)
+	{
+		switch (mode)
+		{
+		case Blend::Multiply: return mul_un8(b, s);
+		case Blend::Screen: return b + s - mul_un8(b, s);
+		case Blend::Overlay: return blend_channel<Blend::HardLight>(s, b);
+		case Blend::Darken: return (b < s ? b : s);
+		case Blend::Lighten: return (b > s ? b : s);
+		case Blend::ColorDodge:
+			if (b == 0)
+				return 0;
+			if (s == 255)
+				return 255;
+			b = div_un8(b, 255 - s);
+			return (b > 255 ? 255 : b);
+		case Blend::ColorBurn:
+			if (b == 255)
+				return 255;
+			if (s == 0)
+				return 0;
+			b = div_un8(255 - b, s);
+			return 255 - (b > 255 ? 255 : b);
+		case Blend::HardLight:
+			if (s < 128)
+				return mul_un8(b, s * 2);
+			s = s * 2 - 255;
+			return b + s - mul_un8(b, s);
+		case Blend::SoftLight: return soft_light(b, s);
+		case Blend::Difference: return (b > s ? b - s : s - b);
+		case Blend::Exclusion: return b + s - 2 * mul_un8(b, s);
+		case Blend::Addition: return (b + s > 255 ? 255 : b + s);
+		case Blend::Subtract: return (b - s < 0 ? 0 : b - s);
+		case Blend::Divide:
+			if (b == 0)
+				return 0;
+			if (b >= s)
+				return 255;
+			return div_un8(b, s);
+		default: return s;
+		}
+	}
+
+#if defined(IMAGEOPS_SSE2)
+	inline __m128i mul_un8_epi16(__m128i a, __m128i b)
+	{
+		__m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(0x80));
+		return _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(t, 8), t), 8);
+	}
+
+	inline __m128i screen_epi16(__m128i b, __m128i s)
+	{
+		return _mm_sub_epi16(_mm_add_epi16(b, s), mul_un8_epi16(b, s));
+	}
+
+	inline __m128i select_epi16(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	// truncated `num / den` for each 16-bit lane, done in float. The numerators stay below 2^17,
+	// so any quotient below 256 truncates to the same value as an integer divide.
+	inline __m128i div_epi16(__m128i num, __m128i den)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		__m128 d0 = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(den, zero)), one);
+		__m128 d1 = _mm_max_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(den, zero)), one);
+		__m128i q0 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(num, zero)), d0));
+		__m128i q1 = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(num, zero)), d1));
+		return _mm_packs_epi32(q0, q1);
+	}
+
+	// `div_un8`, clamped to 255
+	inline __m128i div_un8_epi16(__m128i a, __m128i b)
+	{
+		__m128i num = _mm_add_epi16(_mm_sub_epi16(_mm_slli_epi16(a, 8), a), _mm_srli_epi16(b, 1));
+		return _mm_min_epi16(div_epi16(num, b), _mm_set1_epi16(255));
+	}
+
+	inline __m128 soft_light_ps(__m128 b, __m128 s)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		__m128 poly = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(16.0f), b), _mm_set1_ps(12.0f)), b), _mm_set1_ps(4.0f)), b);
+		__m128 low = _mm_cmple_ps(b, _mm_set1_ps(0.25f));
+		__m128 d = _mm_or_ps(_mm_and_ps(low, poly), _mm_andnot_ps(low, _mm_sqrt_ps(b)));
+
+		__m128 dark = _mm_sub_ps(b, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, s)), b), _mm_sub_ps(one, b)));
+		__m128 light = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(two, s), one), _mm_sub_ps(d, b)));
+		__m128 half = _mm_cmple_ps(s, _mm_set1_ps(0.5f));
+		__m128 r = _mm_or_ps(_mm_and_ps(half, dark), _mm_andnot_ps(half, light));
+
+		return _mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+	}
+
+	// the SIMD version of `blend_channel`, for 8 channels unpacked to 16 bits
+	template<Blend mode>
+	inline __m128i blend_epi16(__m128i b, __m128i s)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(255);
+
+		switch (mode)
+		{
+		case Blend::Multiply: return mul_un8_epi16(b, s);
+		case Blend::Screen: return screen_epi16(b, s);
+		case Blend::Overlay: return blend_epi16<Blend::HardLight>(s, b);
+		case Blend::Darken: return _mm_min_epi16(b, s);
+		case Blend::Lighten: return _mm_max_epi16(b, s);
+		case Blend::ColorDodge:
+		{
+			__m128i r = div_un8_epi16(b, _mm_sub_epi16(full, s));
+			r = select_epi16(_mm_cmpeq_epi16(s, full), full, r);
+			return select_epi16(_mm_cmpeq_epi16(b, zero), zero, r);
+		}
+		case Blend::ColorBurn:
+		{
+			__m128i r = _mm_sub_epi16(full, div_un8_epi16(_mm_sub_epi16(full, b), s));
+			r = select_epi16(_mm_cmpeq_epi16(s, zero), zero, r);
+			return select_epi16(_mm_cmpeq_epi16(b, full), full, r);
+		}
+		case Blend::HardLight:
+		{
+			__m128i s2 = _mm_add_epi16(s, s);
+			__m128i dark = mul_un8_epi16(b, s2);
+			__m128i light = screen_epi16(b, _mm_sub_epi16(s2, full));
+			return select_epi16(_mm_cmplt_epi16(s, _mm_set1_epi16(128)), dark, light);
+		}
+		case Blend::SoftLight:
+		{
+			const __m128 scale = _mm_set1_ps(255.0f);
+			__m128 b0 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), scale);
+			__m128 b1 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero)), scale);
+			__m128 s0 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)), scale);
+			__m128 s1 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)), scale);
+			return _mm_packs_epi32(_mm_cvttps_epi32(soft_light_ps(b0, s0)), _mm_cvttps_epi32(soft_light_ps(b1, s1)));
+		}
+		case Blend::Difference: return _mm_sub_epi16(_mm_max_epi16(b, s), _mm_min_epi16(b, s));
+		case Blend::Exclusion:
+		{
+			__m128i m = mul_un8_epi16(b, s);
+			return _mm_sub_epi16(_mm_add_epi16(b, s), _mm_add_epi16(m, m));
+		}
+		case Blend::Addition: return _mm_min_epi16(_mm_add_epi16(b, s), full);
+		case Blend::Subtract: return _mm_max_epi16(_mm_sub_epi16(b, s), zero);
+		case Blend::Divide:
+		{
+			__m128i r = div_un8_epi16(b, s);
+			r = select_epi16(_mm_cmplt_epi16(b, s), r, full);
+			return select_epi16(_mm_cmpeq_epi16(b, zero), zero, r);
+		}
+		default: return s;
+		}
+	}
+#endif
+
+	// Writes the source colors blended with the backdrop into `out`, keeping the source's alpha.
+	// The blended color is mixed with the source color by the backdrop's alpha.
+	template<Blend mode>
+	void blend_separable(const Color* dst, const Color* src, Color* out, int count)
+	{
+		int i = 0;
+
+#if defined(IMAGEOPS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+		auto mix = [&](__m128i s, __m128i b)
+		{
+			__m128i ba = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, 0xff), 0xff);
+			__m128i t = _mm_add_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(full, ba)), _mm_mullo_epi16(blend_epi16<mode>(b, s), ba));
+			t = _mm_add_epi16(t, _mm_set1_epi16(0x80));
+			t = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(t, 8), t), 8);
+			return select_epi16(alpha, s, t);
+		};
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+			__m128i lo = mix(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+			__m128i hi = mix(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			const Color& b = dst[i];
+			const Color& s = src[i];
+			out[i].r = (uint8_t)mix_un8(s.r, blend_channel<mode>(b.r, s.r), b.a);
+			out[i].g = (uint8_t)mix_un8(s.g, blend_channel<mode>(b.g, s.g), b.a);
+			out[i].b = (uint8_t)mix_un8(s.b, blend_channel<mode>(b.b, s.b), b.a);
+			out[i].a = s.a;
+		}
+	}
+
+	struct Rgb
+	{
+		float r, g, b;
+	};
+
+	inline float lum(const Rgb& c)
+	{
+		return 0.3f * c.r + 0.59f * c.g + 0.11f * c.b;
+	}
+
+	inline float sat(const Rgb& c)
+	{
+		return fmaxf(c.r, fmaxf(c.g, c.b)) - fminf(c.r, fminf(c.g, c.b));
+	}
+
+	Rgb set_lum(Rgb c, float l)
+	{
+		float d = l - lum(c);
+		c.r += d;
+		c.g += d;
+		c.b += d;
+
+		// clip back into range, keeping the luminosity
+		l = lum(c);
+		float n = fminf(c.r, fminf(c.g, c.b));
+		float x = fmaxf(c.r, fmaxf(c.g, c.b));
+
+		if (n < 0.0f)
+		{
+			c.r = l + (c.r - l) * l / (l - n);
+			c.g = l + (c.g - l) * l / (l - n);
+			c.b = l + (c.b - l) * l / (l - n);
+		}
+
+		if (x > 1.0f)
+		{
+			c.r = l + (c.r - l) * (1.0f - l) / (x - l);
+			c.g = l + (c.g - l) * (1.0f - l) / (x - l);
+			c.b = l + (c.b - l) * (1.0f - l) / (x - l);
+		}
+
+		return c;
+	}
+
+	Rgb set_sat(Rgb c, float s)
+	{
+		float* min = &c.r;
+		float* mid = &c.g;
+		float* max = &c.b;
+
+		if (*min > *mid) std::swap(min, mid);
+		if (*mid > *max) std::swap(mid, max);
+		if (*min > *mid) std::swap(min, mid);
+
+		if (*max > *min)
+		{
+			*mid = (*mid - *min) * s / (*max - *min);
+			*max = s;
+		}
+		else
+		{
+			*mid = *max = 0.0f;
+		}
+
+		*min = 0.0f;
+		return c;
+	}
+
+	// the non-separable modes, which work on all three channels at once
+	void blend_nonseparable(Blend mode, const Color* dst, const Color* src, Color* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const Color& bc = dst[i];
+			const Color& sc = src[i];
+			Rgb b = { bc.r / 255.0f, bc.g / 255.0f, bc.b / 255.0f };
+			Rgb s = { sc.r / 255.0f, sc.g / 255.0f, sc.b / 255.0f };
+			Rgb r;
+
+			switch (mode)
+			{
+			case Blend::Hue: r = set_lum(set_sat(s, sat(b)), lum(b)); break;
+			case Blend::Saturation: r = set_lum(set_sat(b, sat(s)), lum(b)); break;
+			case Blend::Color: r = set_lum(s, lum(b)); break;
+			default: r = set_lum(b, lum(s)); break;
+			}
+
+			out[i].r = (uint8_t)mix_un8(sc.r, (int)(fminf(fmaxf(r.r, 0.0f), 1.0f) * 255.0f + 0.5f), bc.a);
+			out[i].g = (uint8_t)mix_un8(sc.g, (int)(fminf(fmaxf(r.g, 0.0f), 1.0f) * 255.0f + 0.5f), bc.a);
+			out[i].b = (uint8_t)mix_un8(sc.b, (int)(fminf(fmaxf(r.b, 0.0f), 1.0f) * 255.0f + 0.5f), bc.a);
+			out[i].a = sc.a;
+		}
+	}
+
+	void blend_colors(Blend mode, const Color* dst, const Color* src, Color* out, int count)
+	{
+		switch (mode)
+		{
+		case Blend::Multiply: blend_separable<Blend::Multiply>(dst, src, out, count); break;
+		case Blend::Screen: blend_separable<Blend::Screen>(dst, src, out, count); break;
+		case Blend::Overlay: blend_separable<Blend::Overlay>(dst, src, out, count); break;
+		case Blend::Darken: blend_separable<Blend::Darken>(dst, src, out, count); break;
+		case Blend::Lighten: blend_separable<Blend::Lighten>(dst, src, out, count); break;
+		case Blend::ColorDodge: blend_separable<Blend::ColorDodge>(dst, src, out, count); break;
+		case Blend::ColorBurn: blend_separable<Blend::ColorBurn>(dst, src, out, count); break;
+		case Blend::HardLight: blend_separable<Blend::HardLight>(dst, src, out, count); break;
+		case Blend::SoftLight: blend_separable<Blend::SoftLight>(dst, src, out, count); break;
+		case Blend::Difference: blend_separable<Blend::Difference>(dst, src, out, count); break;
+		case Blend::Exclusion: blend_separable<Blend::Exclusion>(dst, src, out, count); break;
+		case Blend::Addition: blend_separable<Blend::Addition>(dst, src, out, count); break;
+		case Blend::Subtract: blend_separable<Blend::Subtract>(dst, src, out, count); break;
+		case Blend::Divide: blend_separable<Blend::Divide>(dst, src, out, count); break;
+		case Blend::Hue:
+		case Blend::Saturation:
+		case Blend::Color:
+		case Blend::Luminosity:
+			blend_nonseparable(mode, dst, src, out, count);
+			break;
+		default:
+			memcpy(out, src, sizeof(Color) * count);
+			break;
+		}
+	}
+}
+
+void ImageOps::blend(Color* dst, const Color* src, int64_t count, Blend mode, uint8_t opacity)
+{
+	if (mode == Blend::Normal)
+	{
+		blend_source_over(dst, src, count, opacity);
+		return;
+	}
+
+	// blend a span at a time into a small buffer, which is then drawn with source-over
+	constexpr int span = 256;
+	Color buffer[span];
+
+	for (int64_t i = 0; i < count; i += span)
+	{
+		int n = (int)(count - i < span ? count - i : span);
+		blend_colors(mode, dst + i, src + i, buffer, n);
+		blend_source_over(dst + i, buffer, n, opacity);
+	}
+}
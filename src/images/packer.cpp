@@ -1,15 +1,352 @@
 #include <blah/images/packer.h>
+#include <blah/images/imageops.h>
 #include <blah/core/log.h>
+#include <blah/math/calc.h>
+#include <blah/streams/memorystream.h>
+#include "../internal/parallel.h"
 #include <algorithm>
 #include <cstring>
+#include <mutex>
 
 using namespace Blah;
 
+namespace
+{
+	// source pixels are allocated in blocks of 4mb, or larger for images that don't fit
+	constexpr int64_t chunk_pixels = 1024 * 1024;
+
+	// Gets row `y` of a `w` x `h` source image, which may be stored rotated 90 degrees clockwise
+	const Color* source_row(const Color* pixels, int stride, bool rotated, int w, int h, int y, Color* scratch)
+	{
+		if (!rotated)
+			return pixels + (int64_t)y * stride;
+
+		for (int x = 0; x < w; x++)
+			scratch[x] = pixels[(h - 1 - y) + (int64_t)x * stride];
+		return scratch;
+	}
+
+	struct Placement
+	{
+		int x = 0;
+		int y = 0;
+		bool rotated = false;
+		bool placed = false;
+	};
+
+	bool rect_contains(const RectI& a, const RectI& b)
+	{
+		return b.x >= a.x && b.y >= a.y && b.x + b.w <= a.x + a.w && b.y + b.h <= a.y + a.h;
+	}
+
+	// Maximal Rectangles bin, placing with the Best Short Side Fit.
+	// The free rectangles are stored by the caller, so a bin can be picked up again later.
+	class MaxRectsBin
+	{
+	public:
+		MaxRectsBin(Vector<RectI>& free)
+			: m_free(free) {}
+
+		void reset(int width, int height)
+		{
+			m_free.clear();
+			m_free.push_back(RectI(0, 0, width, height));
+		}
+
+		bool insert(int w, int h, bool allow_rotation, Placement* result)
+		{
+			int best_short = INT32_MAX;
+			int best_long = INT32_MAX;
+			RectI best;
+			bool rotated = false;
+
+			auto consider = [&](const RectI& rect, int rw, int rh, bool rotate)
+			{
+				if (rw > rect.w || rh > rect.h)
+					return;
+
+				int leftover_w = rect.w - rw;
+				int leftover_h = rect.h - rh;
+				int short_side = std::min(leftover_w, leftover_h);
+				int long_side = std::max(leftover_w, leftover_h);
+
+				if (short_side < best_short || (short_side == best_short && long_side < best_long))
+				{
+					best_short = short_side;
+					best_long = long_side;
+					best = RectI(rect.x, rect.y, rw, rh);
+					rotated = rotate;
+				}
+			};
+
+			for (auto& it : m_free)
+			{
+				consider(it, w, h, false);
+				if (allow_rotation && w != h)
+					consider(it, h, w, true);
+			}
+
+			if (best_short == INT32_MAX)
+				return false;
+
+			place(best);
+			result->x = best.x;
+			result->y = best.y;
+			result->rotated = rotated;
+			result->placed = true;
+			return true;
+		}
+
+		// marks the given area as used
+		void place(const RectI& used)
+		{
+			m_created.clear();
+
+			// split every free rectangle the placed one overlaps
+			for (int i = 0; i < m_free.size();)
+			{
+				RectI rect = m_free[i];
+
+				if (rect.x >= used.x + used.w || rect.x + rect.w <= used.x ||
+					rect.y >= used.y + used.h || rect.y + rect.h <= used.y)
+				{
+					i++;
+					continue;
+				}
+
+				if (used.x > rect.x)
+					m_created.push_back(RectI(rect.x, rect.y, used.x - rect.x, rect.h));
+				if (used.x + used.w < rect.x + rect.w)
+					m_created.push_back(RectI(used.x + used.w, rect.y, rect.x + rect.w - used.x - used.w, rect.h));
+				if (used.y > rect.y)
+					m_created.push_back(RectI(rect.x, rect.y, rect.w, used.y - rect.y));
+				if (used.y + used.h < rect.y + rect.h)
+					m_created.push_back(RectI(rect.x, used.y + used.h, rect.w, rect.y + rect.h - used.y - used.h));
+
+				m_free[i] = m_free.back();
+				m_free.pop();
+			}
+
+			// only keep the new rectangles that aren't inside another one.
+			// the remaining old ones are maximal, so they can't be inside a new one.
+			int old_count = m_free.size();
+			for (int i = 0; i < m_created.size(); i++)
+			{
+				bool contained = false;
+
+				for (int j = 0; j < m_created.size() && !contained; j++)
+					if (i != j && rect_contains(m_created[j], m_created[i]) && (j < i || !(m_created[j] == m_created[i])))
+						contained = true;
+
+				for (int j = 0; j < old_count && !contained; j++)
+					if (rect_contains(m_free[j], m_created[i]))
+						contained = true;
+
+				if (!contained)
+					m_free.push_back(m_created[i]);
+			}
+		}
+
+	private:
+		Vector<RectI>& m_free;
+		Vector<RectI> m_created;
+	};
+
+	// Skyline bin, placing each rectangle where its top edge ends up lowest
+	class SkylineBin
+	{
+	public:
+		SkylineBin(int width, int height)
+			: m_width(width), m_height(height)
+		{
+			m_skyline.push_back({ 0, 0, width });
+		}
+
+		bool insert(int w, int h, bool allow_rotation, Placement* result)
+		{
+			int best_top = INT32_MAX;
+			int best_x = INT32_MAX;
+			int best_index = -1;
+			int best_y = 0;
+			bool rotated = false;
+
+			auto consider = [&](int index, int rw, int rh, bool rotate)
+			{
+				int y = fit(index, rw, rh);
+				if (y < 0)
+					return;
+
+				int x = m_skyline[index].x;
+				if (y + rh < best_top || (y + rh == best_top && x < best_x))
+				{
+					best_top = y + rh;
+					best_x = x;
+					best_y = y;
+					best_index = index;
+					rotated = rotate;
+				}
+			};
+
+			for (int i = 0; i < m_skyline.size(); i++)
+			{
+				consider(i, w, h, false);
+				if (allow_rotation && w != h)
+					consider(i, h, w, true);
+			}
+
+			if (best_index < 0)
+				return false;
+
+			if (rotated)
+				std::swap(w, h);
+
+			place(best_index, best_x, best_y, w, h);
+			result->x = best_x;
+			result->y = best_y;
+			result->rotated = rotated;
+			result->placed = true;
+			return true;
+		}
+
+	private:
+		struct Segment
+		{
+			int x;
+			int y;
+			int w;
+		};
+
+		int m_width;
+		int m_height;
+		Vector<Segment> m_skyline;
+
+		// returns the y position a rectangle would sit at, starting at the given segment, or -1
+		int fit(int index, int w, int h) const
+		{
+			int x = m_skyline[index].x;
+			if (x + w > m_width)
+				return -1;
+
+			int y = 0;
+			for (int i = index, remaining = w; remaining > 0; i++)
+			{
+				y = std::max(y, m_skyline[i].y);
+				if (y + h > m_height)
+					return -1;
+				remaining -= m_skyline[i].w;
+			}
+
+			return y;
+		}
+
+		void place(int index, int x, int y, int w, int h)
+		{
+			// insert the new segment
+			Segment segment = { x, y + h, w };
+			m_skyline.push_back(segment);
+			for (int i = m_skyline.size() - 1; i > index; i--)
+				m_skyline[i] = m_skyline[i - 1];
+			m_skyline[index] = segment;
+
+			// shrink or remove the segments underneath it
+			for (int i = index + 1; i < m_skyline.size();)
+			{
+				auto& it = m_skyline[i];
+				int overlap = segment.x + segment.w - it.x;
+				if (overlap <= 0)
+					break;
+
+				it.x += overlap;
+				it.w -= overlap;
+				if (it.w > 0)
+					break;
+
+				m_skyline.erase(i);
+			}
+
+			// merge segments of the same height
+			for (int i = 0; i < m_skyline.size() - 1;)
+			{
+				if (m_skyline[i].y == m_skyline[i + 1].y)
+				{
+					m_skyline[i].w += m_skyline[i + 1].w;
+					m_skyline.erase(i + 1);
+				}
+				else
+					i++;
+			}
+		}
+	};
+
+	template<class Bin>
+	int place_all(Bin& bin, const Vector<Packer::Entry*>& entries, bool allow_rotation, int border, Vector<Placement>& placements, int* used_w, int* used_h)
+	{
+		int placed = 0;
+
+		for (int i = 0; i < entries.size(); i++)
+		{
+			int w = entries[i]->packed.w + border;
+			int h = entries[i]->packed.h + border;
+			auto& placement = placements[i];
+
+			if (bin.insert(w, h, allow_rotation, &placement))
+			{
+				if (placement.rotated)
+					std::swap(w, h);
+
+				*used_w = std::max(*used_w, placement.x + w);
+				*used_h = std::max(*used_h, placement.y + h);
+				placed++;
+			}
+		}
+
+		return placed;
+	}
+
+	// tries to place every entry in a bin of the given size, and returns how many fit
+	int place_rects(Packer::Algorithm algorithm, int width, int height, const Vector<Packer::Entry*>& entries, bool allow_rotation, int border, Vector<Placement>& placements, int* used_w, int* used_h)
+	{
+		placements.clear();
+		placements.resize(entries.size());
+		*used_w = 0;
+		*used_h = 0;
+
+		if (algorithm == Packer::Algorithm::Skyline)
+		{
+			SkylineBin bin(width, height);
+			return place_all(bin, entries, allow_rotation, border, placements, used_w, used_h);
+		}
+		else
+		{
+			Vector<RectI> free;
+			MaxRectsBin bin(free);
+			bin.reset(width, height);
+			return place_all(bin, entries, allow_rotation, border, placements, used_w, used_h);
+		}
+	}
+
+	Point calc_page_size(int width, int height, bool power_of_two)
+	{
+		if (power_of_two)
+		{
+			int page_width = 2;
+			int page_height = 2;
+			while (page_width < width)
+				page_width *= 2;
+			while (page_height < height)
+				page_height *= 2;
+			return Point(page_width, page_height);
+		}
+
+		return Point(width, height);
+	}
+}
+
 Packer::Packer()
-	: max_size(8192), power_of_two(true), spacing(1), padding(1), m_dirty(false) { }
+	: max_size(8192), power_of_two(true), spacing(1), padding(1), algorithm(Algorithm::Tree), allow_rotation(false), incremental(false), repack_threshold(0.25f), m_dirty(false), m_packed_count(0), m_packed_settings(0) { }
 
 Packer::Packer(int max_size, int spacing, bool power_of_two)
-	: max_size(max_size), power_of_two(power_of_two), spacing(spacing), padding(1), m_dirty(false) { }
+	: max_size(max_size), power_of_two(power_of_two), spacing(spacing), padding(1), algorithm(Algorithm::Tree), allow_rotation(false), incremental(false), repack_threshold(0.25f), m_dirty(false), m_packed_count(0), m_packed_settings(0) { }
 
 Packer::Packer(Packer&& src) noexcept
 {
@@ -17,10 +354,18 @@ Packer::Packer(Packer&& src) noexcept
 	power_of_two = src.power_of_two;
 	spacing = src.spacing;
 	padding = src.padding;
+	algorithm = src.algorithm;
+	allow_rotation = src.allow_rotation;
+	incremental = src.incremental;
+	repack_threshold = src.repack_threshold;
 	m_dirty = src.m_dirty;
 	pages = std::move(src.pages);
 	entries = std::move(src.entries);
-	m_buffer = std::move(src.m_buffer);
+	changes = std::move(src.changes);
+	m_chunks = std::move(src.m_chunks);
+	m_packed_count = src.m_packed_count;
+	m_packed_settings = src.m_packed_settings;
+	m_free = std::move(src.m_free);
 }
 
 Packer& Packer::operator=(Packer&& src) noexcept
@@ -29,10 +374,19 @@ Packer& Packer::operator=(Packer&& src) noexcept
 	power_of_two = src.power_of_two;
 	spacing = src.spacing;
 	padding = src.padding;
+	algorithm = src.algorithm;
+	allow_rotation = src.allow_rotation;
+	incremental = src.incremental;
+	repack_threshold = src.repack_threshold;
 	m_dirty = src.m_dirty;
 	pages = std::move(src.pages);
 	entries = std::move(src.entries);
-	m_buffer = std::move(src.m_buffer);
+	changes = std::move(src.changes);
+	free_chunks();
+	m_chunks = std::move(src.m_chunks);
+	m_packed_count = src.m_packed_count;
+	m_packed_settings = src.m_packed_settings;
+	m_free = std::move(src.m_free);
 	return *this;
 }
 
@@ -41,14 +395,14 @@ Packer::~Packer()
 	dispose();
 }
 
-void Packer::add(uint64_t id, int width, int height, const Color* pixels)
+void Packer::add(uint64_t id, int width, int height, const Color* pixels, bool borrow)
 {
-	add_entry(id, width, height, pixels);
+	add_entry(id, width, height, pixels, borrow);
 }
 
-void Packer::add(uint64_t id, const Image& image)
+void Packer::add(uint64_t id, const Image& image, bool borrow)
 {
-	add_entry(id, image.width, image.height, image.pixels);
+	add_entry(id, image.width, image.height, image.pixels, borrow);
 }
 
 void Packer::add(uint64_t id, const String& path)
@@ -56,86 +410,151 @@ void Packer::add(uint64_t id, const String& path)
 	add(id, Image(path.cstr()));
 }
 
-void Packer::add_entry(uint64_t id, int w, int h, const Color* pixels)
+void Packer::add(uint64_t id, int width, int height)
+{
+	m_dirty = true;
+
+	Entry entry(id, RectI(0, 0, width, height));
+	entry.reserved = true;
+
+	if (width > 0 && height > 0)
+	{
+		entry.empty = false;
+		entry.packed.w = width;
+		entry.packed.h = height;
+	}
+
+	entries.push_back(entry);
+}
+
+void Packer::add_entry(uint64_t id, int w, int h, const Color* pixels, bool borrow)
 {
 	m_dirty = true;
 
 	Entry entry(id, RectI(0, 0, w, h));
 
 	// trim
-	int top = 0, left = 0, right = 0, bottom = 0;
-
-	// TOP:
-	for (int y = 0; y < h; y++)
-		for (int x = 0, s = y * w; x < w; x++, s++)
-			if (pixels[s].a > 0)
-			{
-				top = y;
-				goto JUMP_LEFT;
-			}
-	JUMP_LEFT:
-	for (int x = 0; x < w; x++)
-		for (int y = top, s = x + y * w; y < h; y++, s += w)
-			if (pixels[s].a > 0)
-			{
-				left = x;
-				goto JUMP_RIGHT;
-			}
-	JUMP_RIGHT:
-	for (int x = w - 1; x >= left; x--)
-		for (int y = top, s = x + y * w; y < h; y++, s += w)
-			if (pixels[s].a > 0)
-			{
-				right = x + 1;
-				goto JUMP_BOTTOM;
-			}
-	JUMP_BOTTOM:
-	for (int y = h - 1; y >= top; y--)
-		for (int x = left, s = x + y * w; x < right; x++, s++)
-			if (pixels[s].a > 0)
-			{
-				bottom = y + 1;
-				goto JUMP_END;
-			}
-	JUMP_END:;
+	RectI bounds;
 
 	// pixels actually exist in this source
-	if (right >= left && bottom >= top)
+	if (ImageOps::alpha_bounds(pixels, w, h, &bounds))
 	{
 		entry.empty = false;
 
 		// store size
-		entry.frame.x = -left;
-		entry.frame.y = -top;
-		entry.packed.w = (right - left);
-		entry.packed.h = (bottom - top);
+		entry.frame.x = -bounds.x;
+		entry.frame.y = -bounds.y;
+		entry.packed.w = bounds.w;
+		entry.packed.h = bounds.h;
 
-		// create pixel data
-		entry.memory_index = m_buffer.position();
+		const Color* trimmed = pixels + bounds.x + (int64_t)bounds.y * w;
 
-		// copy pixels over
-		if (entry.packed.w == w && entry.packed.h == h)
+		if (borrow)
 		{
-			m_buffer.write((char*)pixels, sizeof(Color) * w * h);
+			entry.source = trimmed;
+			entry.source_stride = w;
 		}
 		else
 		{
-			for (int i = 0; i < entry.packed.h; i++)
-				m_buffer.write((char*)(pixels + left + (top + i) * entry.frame.w), sizeof(Color) * entry.packed.w);
+			// find room in the last chunk, or allocate a new one
+			int64_t size = (int64_t)bounds.w * bounds.h;
+			if (m_chunks.size() <= 0 || m_chunks.back().pixels == nullptr || m_chunks.back().capacity - m_chunks.back().used < size)
+			{
+				Chunk chunk;
+				chunk.capacity = Calc::max(size, (int64_t)chunk_pixels);
+				chunk.pixels = new Color[chunk.capacity];
+				chunk.used = 0;
+				chunk.references = 0;
+				m_chunks.push_back(chunk);
+			}
+
+			Chunk& chunk = m_chunks.back();
+			Color* dst = chunk.pixels + chunk.used;
+			chunk.used += size;
+			chunk.references++;
+
+			for (int i = 0; i < bounds.h; i++)
+				memcpy(dst + (int64_t)i * bounds.w, trimmed + (int64_t)i * w, sizeof(Color) * bounds.w);
+
+			entry.source = dst;
+			entry.source_stride = bounds.w;
+			entry.source_chunk = m_chunks.size() - 1;
 		}
 	}
 
 	entries.push_back(entry);
 }
 
+void Packer::free_chunks()
+{
+	for (auto& it : m_chunks)
+		delete[] it.pixels;
+	m_chunks.clear();
+}
+
 void Packer::pack()
 {
 	if (!m_dirty)
 		return;
 
 	m_dirty = false;
+	changes.clear();
+
+	// try to fit new entries around the existing ones
+	if (incremental && pack_incremental())
+		return;
+
+	for (auto& it : entries)
+	{
+		if (it.empty)
+			continue;
+
+		// make sure none are too large, including the spacing they're placed with
+		if (it.packed.w + padding * 2 + spacing > max_size || it.packed.h + padding * 2 + spacing > max_size)
+		{
+			BLAH_ERROR("Source image is larger than max atlas size");
+			return;
+		}
+
+		// make sure the ones that were already packed can be read back out of their page
+		if (it.source == nullptr && !it.reserved && (it.page < 0 || it.page >= pages.size() ||
+			it.packed.x + it.packed.w > pages[it.page].width ||
+			it.packed.y + it.packed.h > pages[it.page].height))
+		{
+			BLAH_ERROR("Packer pages were modified after packing, and can't be repacked");
+			return;
+		}
+	}
+
+	// placing the entries can still fail, which puts them back as they were
+	Vector<Entry> restore = entries;
+
+	// entries that were already packed are copied out of the old pages,
+	// so those stay alive until the new ones have been composed
+	Vector<Image> previous = std::move(pages);
+	for (auto& it : entries)
+	{
+		if (it.empty || it.reserved || it.source != nullptr)
+			continue;
+
+		Image& page = previous[it.page];
+		it.source = page.pixels + it.packed.x + (int64_t)it.packed.y * page.width;
+		it.source_stride = page.width;
+		it.source_rotated = it.rotated;
+	}
+
 	pages.clear();
 
+	// undo the rotation from the last time we packed
+	for (auto& it : entries)
+	{
+		if (it.rotated)
+		{
+			std::swap(it.packed.w, it.packed.h);
+			it.rotated = false;
+		}
+	}
+
 	// only if we have stuff to pack
 	auto count = entries.size();
 	if (count > 0)
@@ -155,144 +574,825 @@ void Packer::pack()
 			});
 		}
 
-		// make sure the largest isn't too large
-		if (sources[0]->packed.w + padding * 2 > max_size || sources[0]->packed.h + padding * 2 > max_size)
+		// place the entries
+		Vector<Point> page_sizes;
+		if (algorithm == Algorithm::Tree)
 		{
-			BLAH_ERROR("Source image is larger than max atlas size");
+			pack_tree(sources, page_sizes);
+		}
+		else if (!pack_rects(sources, page_sizes))
+		{
+			entries = std::move(restore);
+			pages = std::move(previous);
+			m_dirty = true;
 			return;
 		}
 
-		// we should never need more nodes than source images * 3
-		// if this causes problems we could change it to use push_back I suppose
-		Vector<Node> nodes;
-		nodes.resize(count * 4);
+		// create each page
+		for (int i = 0; i < page_sizes.size(); i++)
+		{
+			pages.emplace_back();
+			pages.back().width = page_sizes[i].x;
+			pages.back().height = page_sizes[i].y;
 
-		int packed = 0, page = 0;
-		while (packed < count)
+			Change change;
+			change.page = i;
+			change.rect = RectI(0, 0, page_sizes[i].x, page_sizes[i].y);
+			changes.push_back(change);
+		}
+
+		// copy image data to the pages
+		for (auto& it : entries)
 		{
-			if (sources[packed]->empty)
+			if (it.empty)
+				it.page = (pages.size() > 0 ? pages.size() - 1 : 0);
+		}
+
+		compose(sources);
+	}
+
+	m_free.clear();
+	m_packed_count = entries.size();
+	m_packed_settings = calc_settings();
+}
+
+bool Packer::pack_incremental()
+{
+	if (pages.size() <= 0 || m_packed_count <= 0 || m_packed_count > entries.size() || m_packed_settings != calc_settings())
+		return false;
+
+	// repack everything once the pages get too sparse
+	{
+		// only the entries that were packed last time have a place yet
+		int64_t used = 0, total = 0;
+		for (int i = 0; i < m_packed_count; i++)
+			if (!entries[i].empty && entries[i].page < pages.size())
+				used += (int64_t)entries[i].packed.w * entries[i].packed.h;
+		for (auto& it : pages)
+			total += (int64_t)it.width * it.height;
+
+		if (total <= 0 || (float)((double)used / total) < repack_threshold)
+			return false;
+	}
+
+	int border = padding * 2 + spacing;
+	bool rotate = allow_rotation && algorithm != Algorithm::Tree;
+	Vector<Entry*> placed;
+
+	// finds the free space of a page of the given size, with everything placed on it so far
+	auto find_free = [&](int page, int width, int height, Vector<RectI>& free)
+	{
+		MaxRectsBin bin(free);
+		bin.reset(width, height);
+
+		auto place = [&](const Entry& it)
+		{
+			if (!it.empty && it.page == page)
+				bin.place(RectI(it.packed.x - padding, it.packed.y - padding, it.packed.w + border, it.packed.h + border));
+		};
+
+		for (int i = 0; i < m_packed_count; i++)
+			place(entries[i]);
+		for (auto& it : placed)
+			place(*it);
+	};
+
+	// rebuild the free space of any pages we haven't tracked yet
+	auto track_pages = [&]()
+	{
+		for (int page = m_free.size(); page < pages.size(); page++)
+			find_free(page, pages[page].width, pages[page].height, *m_free.expand());
+	};
+
+	// places an entry in the free space of a page, or grows a page that's smaller than
+	// the max size until it fits. pages only grow when nothing fits as they are.
+	auto insert = [&](Entry* it, Placement* placement)
+	{
+		for (int page = 0; page < pages.size(); page++)
+		{
+			MaxRectsBin bin(m_free[page]);
+			if (bin.insert(it->packed.w + border, it->packed.h + border, rotate, placement))
 			{
-				packed++;
-				continue;
+				it->page = page;
+				return true;
 			}
+		}
 
-			int from = packed;
-			int index = 0;
-			Node* root = nodes[index++].Reset(RectI(0, 0, sources[from]->packed.w + padding * 2 + spacing, sources[from]->packed.h + padding * 2 + spacing));
+		Vector<RectI> free;
+		for (int page = 0; page < pages.size(); page++)
+		{
+			int width = pages[page].width;
+			int height = pages[page].height;
 
-			while (packed < count)
+			while (width < max_size || height < max_size)
 			{
-				if (sources[packed]->empty)
-				{
-					packed++;
+				if (height >= max_size || (width <= height && width < max_size))
+					width = Calc::min(width * 2, max_size);
+				else
+					height = Calc::min(height * 2, max_size);
+
+				find_free(page, width, height, free);
+				MaxRectsBin bin(free);
+				if (!bin.insert(it->packed.w + border, it->packed.h + border, rotate, placement))
 					continue;
+
+				// move the page's pixels over, and re-upload all of it
+				auto& image = pages[page];
+				if (image.pixels != nullptr)
+				{
+					Image grown(width, height);
+					for (int y = 0; y < image.height; y++)
+						memcpy(grown.pixels + (int64_t)y * width, image.pixels + (int64_t)y * image.width, sizeof(Color) * image.width);
+					image = std::move(grown);
 				}
 
-				int w = sources[packed]->packed.w + padding * 2 + spacing;
-				int h = sources[packed]->packed.h + padding * 2 + spacing;
+				image.width = width;
+				image.height = height;
+				m_free[page] = std::move(free);
+				it->page = page;
 
-				Node* node = root->Find(w, h);
+				Change change;
+				change.page = page;
+				change.rect = RectI(0, 0, width, height);
+				changes.push_back(change);
+				return true;
+			}
+		}
+
+		return false;
+	};
 
-				// try to expand
-				if (node == nullptr)
+	track_pages();
+
+	// get the new entries, sorted largest -> smallest
+	Vector<Entry*> added;
+	for (int i = m_packed_count; i < entries.size(); i++)
+	{
+		if (entries[i].empty)
+			entries[i].page = pages.size() - 1;
+		else
+			added.push_back(&entries[i]);
+	}
+
+	std::sort(added.begin(), added.end(), [](Packer::Entry* a, Packer::Entry* b)
+	{
+		return a->packed.w * a->packed.h > b->packed.w * b->packed.h;
+	});
+
+	for (auto& it : added)
+	{
+		if (it->packed.w + padding * 2 + spacing > max_size || it->packed.h + padding * 2 + spacing > max_size)
+		{
+			BLAH_ERROR("Source image is larger than max atlas size");
+			return true;
+		}
+	}
+
+	// place them in the free space of the existing pages
+	Vector<Entry*> leftover;
+	for (auto& it : added)
+	{
+		Placement placement;
+
+		if (!insert(it, &placement))
+		{
+			leftover.push_back(it);
+			continue;
+		}
+
+		if (placement.rotated)
+			std::swap(it->packed.w, it->packed.h);
+
+		it->rotated = placement.rotated;
+		it->packed.x = placement.x + padding;
+		it->packed.y = placement.y + padding;
+		placed.push_back(it);
+
+		// the padding may extend past the page edge
+		Change change;
+		change.page = it->page;
+		change.rect.x = Calc::max(0, it->packed.x - padding);
+		change.rect.y = Calc::max(0, it->packed.y - padding);
+		change.rect.w = Calc::min(pages[it->page].width, it->packed.x + it->packed.w + padding) - change.rect.x;
+		change.rect.h = Calc::min(pages[it->page].height, it->packed.y + it->packed.h + padding) - change.rect.y;
+		changes.push_back(change);
+	}
+
+	// anything that didn't fit goes onto new pages
+	if (leftover.size() > 0)
+	{
+		int first = pages.size();
+
+		Vector<Point> page_sizes;
+		for (auto& it : pages)
+			page_sizes.push_back(Point(it.width, it.height));
+
+		if (!pack_rects(leftover, page_sizes))
+			return true;
+
+		// new pages are only as large as they need to be, and grow later if they have to
+		for (int i = first; i < page_sizes.size(); i++)
+		{
+			pages.emplace_back();
+			pages.back().width = page_sizes[i].x;
+			pages.back().height = page_sizes[i].y;
+
+			Change change;
+			change.page = i;
+			change.rect = RectI(0, 0, page_sizes[i].x, page_sizes[i].y);
+			changes.push_back(change);
+		}
+
+		for (auto& it : leftover)
+			placed.push_back(it);
+	}
+
+	compose(placed);
+
+	m_packed_count = entries.size();
+	track_pages();
+	return true;
+}
+
+void Packer::compose(const Vector<Entry*>& list)
+{
+	// group the entries by page, so each page can be written to by a single thread
+	Vector<Vector<Entry*>> by_page;
+	by_page.resize(pages.size());
+	for (auto& it : list)
+		if (!it->empty && !it->reserved)
+			by_page[it->page].push_back(it);
+
+	std::mutex chunk_mutex;
+
+	Parallel::for_each(by_page.size(), [&](int index)
+	{
+		// pages are only given pixels once something with pixels is placed on them
+		Image& page = pages[index];
+		if (page.pixels == nullptr && by_page[index].size() > 0)
+			page = Image(page.width, page.height);
+
+		Vector<Color> scratch;
+
+		for (auto& entry : by_page[index])
+		{
+			RectI dst = entry->packed;
+
+			const Color* base;
+			int base_stride;
+			bool base_rotated;
+			source_pixels(*entry, &base, &base_stride, &base_rotated);
+
+			const Color* src = base;
+			int src_stride = base_stride;
+
+			if (entry->rotated != base_rotated)
+			{
+				scratch.resize(dst.w * dst.h);
+				src = scratch.data();
+				src_stride = dst.w;
+
+				// rotate 90 degrees clockwise
+				if (entry->rotated)
 				{
-					bool canGrowDown = (w <= root->rect.w) && (root->rect.h + h < max_size);
-					bool canGrowRight = (h <= root->rect.h) && (root->rect.w + w < max_size);
-					bool shouldGrowRight = canGrowRight && (root->rect.h >= (root->rect.w + w));
-					bool shouldGrowDown = canGrowDown && (root->rect.w >= (root->rect.h + h));
+					int src_w = dst.h;
+					int src_h = dst.w;
 
-					if (canGrowDown || canGrowRight)
-					{
-						// grow right
-						if (shouldGrowRight || (!shouldGrowDown && canGrowRight))
-						{
-							Node* next = nodes[index++].Reset(RectI(0, 0, root->rect.w + w, root->rect.h));
-							next->used = true;
-							next->down = root;
-							next->right = node = nodes[index++].Reset(RectI(root->rect.w, 0, w, root->rect.h));
-							root = next;
-						}
-						// grow down
-						else
-						{
-							Node* next = nodes[index++].Reset(RectI(0, 0, root->rect.w, root->rect.h + h));
-							next->used = true;
-							next->down = node = nodes[index++].Reset(RectI(0, root->rect.h, root->rect.w, h));
-							next->right = root;
-							root = next;
-						}
-					}
+					for (int y = 0; y < src_h; y++)
+						for (int x = 0; x < src_w; x++)
+							scratch[(src_h - 1 - y) + x * dst.w] = base[x + (int64_t)y * base_stride];
 				}
+				// undo the rotation it was stored with
+				else
+				{
+					for (int y = 0; y < dst.h; y++)
+						source_row(base, base_stride, true, dst.w, dst.h, y, scratch.data() + (int64_t)y * dst.w);
+				}
+			}
 
-				// doesn't fit
-				if (node == nullptr)
-					break;
+			// copy the rows over, extruding the edge pixels out into the padding
+			int x0 = Calc::max(0, dst.x - padding);
+			int x1 = Calc::min(page.width, dst.x + dst.w + padding);
+			int y0 = Calc::max(0, dst.y - padding);
+			int y1 = Calc::min(page.height, dst.y + dst.h + padding);
 
-				// add
-				node->used = true;
-				node->down = nodes[index++].Reset(RectI(node->rect.x, node->rect.y + h, node->rect.w, node->rect.h - h));
-				node->right = nodes[index++].Reset(RectI(node->rect.x + w, node->rect.y, node->rect.w - w, h));
+			for (int y = y0; y < y1; y++)
+			{
+				const Color* row = src + (int64_t)Calc::clamp_int(y - dst.y, 0, dst.h - 1) * src_stride;
+				Color* out = page.pixels + (int64_t)y * page.width;
 
-				sources[packed]->packed.x = node->rect.x + padding;
-				sources[packed]->packed.y = node->rect.y + padding;
-				packed++;
+				for (int x = x0; x < dst.x; x++)
+					out[x] = row[0];
+
+				memcpy(out + dst.x, row, sizeof(Color) * dst.w);
+
+				for (int x = dst.x + dst.w; x < x1; x++)
+					out[x] = row[dst.w - 1];
 			}
+		}
 
-			// get page size
-			int pageWidth, pageHeight;
-			if (power_of_two)
+		// the sources are in the page now, so they can be freed
+		{
+			std::lock_guard<std::mutex> lock(chunk_mutex);
+			for (auto& entry : by_page[index])
 			{
-				pageWidth = 2;
-				pageHeight = 2;
-				while (pageWidth < root->rect.w)
-					pageWidth *= 2;
-				while (pageHeight < root->rect.h)
-					pageHeight *= 2;
+				if (entry->source_chunk >= 0)
+				{
+					Chunk& chunk = m_chunks[entry->source_chunk];
+					if (--chunk.references <= 0)
+					{
+						delete[] chunk.pixels;
+						chunk.pixels = nullptr;
+					}
+				}
 			}
-			else
+		}
+
+		for (auto& entry : by_page[index])
+		{
+			entry->source = nullptr;
+			entry->source_stride = 0;
+			entry->source_chunk = -1;
+			entry->source_rotated = false;
+		}
+	});
+}
+
+bool Packer::source_pixels(const Entry& entry, const Color** pixels, int* stride, bool* rotated) const
+{
+	if (entry.source != nullptr)
+	{
+		*pixels = entry.source;
+		*stride = entry.source_stride;
+		*rotated = entry.source_rotated;
+		return true;
+	}
+
+	if (entry.page < 0 || entry.page >= pages.size())
+		return false;
+
+	auto& page = pages[entry.page];
+	*pixels = page.pixels + entry.packed.x + (int64_t)entry.packed.y * page.width;
+	*stride = page.width;
+	*rotated = entry.rotated;
+	return true;
+}
+
+uint64_t Packer::calc_settings() const
+{
+	uint64_t hash = 5381;
+	auto combine = [&](uint64_t value) { hash = ((hash << 5) + hash) ^ value; };
+
+	combine((uint64_t)max_size);
+	combine(power_of_two ? 1 : 0);
+	combine((uint64_t)spacing);
+	combine((uint64_t)padding);
+	combine((uint64_t)algorithm);
+	combine(allow_rotation ? 1 : 0);
+	return hash;
+}
+
+void Packer::pack_tree(Vector<Entry*>& sources, Vector<Point>& page_sizes)
+{
+	int count = sources.size();
+
+	// we should never need more nodes than source images * 3
+	// if this causes problems we could change it to use push_back I suppose
+	Vector<Node> nodes;
+	nodes.resize(count * 4);
+
+	int packed = 0, page = 0;
+	while (packed < count)
+	{
+		if (sources[packed]->empty)
+		{
+			packed++;
+			continue;
+		}
+
+		int from = packed;
+		int index = 0;
+		Node* root = nodes[index++].Reset(RectI(0, 0, sources[from]->packed.w + padding * 2 + spacing, sources[from]->packed.h + padding * 2 + spacing));
+
+		while (packed < count)
+		{
+			if (sources[packed]->empty)
 			{
-				pageWidth = root->rect.w;
-				pageHeight = root->rect.h;
+				packed++;
+				continue;
 			}
 
-			// create each page
+			int w = sources[packed]->packed.w + padding * 2 + spacing;
+			int h = sources[packed]->packed.h + padding * 2 + spacing;
+
+			Node* node = root->Find(w, h);
+
+			// try to expand
+			if (node == nullptr)
 			{
-				pages.emplace_back(pageWidth, pageHeight);
+				bool canGrowDown = (w <= root->rect.w) && (root->rect.h + h < max_size);
+				bool canGrowRight = (h <= root->rect.h) && (root->rect.w + w < max_size);
+				bool shouldGrowRight = canGrowRight && (root->rect.h >= (root->rect.w + w));
+				bool shouldGrowDown = canGrowDown && (root->rect.w >= (root->rect.h + h));
 
-				// copy image data to image
-				for (int i = from; i < packed; i++)
+				if (canGrowDown || canGrowRight)
 				{
-					sources[i]->page = page;
-					if (!sources[i]->empty)
+					// grow right
+					if (shouldGrowRight || (!shouldGrowDown && canGrowRight))
 					{
-						RectI dst = sources[i]->packed;
-						Color* src = (Color*)(m_buffer.data() + sources[i]->memory_index);
+						Node* next = nodes[index++].Reset(RectI(0, 0, root->rect.w + w, root->rect.h));
+						next->used = true;
+						next->down = root;
+						next->right = node = nodes[index++].Reset(RectI(root->rect.w, 0, w, root->rect.h));
+						root = next;
+					}
+					// grow down
+					else
+					{
+						Node* next = nodes[index++].Reset(RectI(0, 0, root->rect.w, root->rect.h + h));
+						next->used = true;
+						next->down = node = nodes[index++].Reset(RectI(0, root->rect.h, root->rect.w, h));
+						next->right = root;
+						root = next;
+					}
+				}
+			}
 
-						// TODO:
-						// Optimize this?
-						if (padding > 0)
-						{
-							pages[page].set_pixels(RectI(dst.x - padding, dst.y, dst.w, dst.h), src);
-							pages[page].set_pixels(RectI(dst.x + padding, dst.y, dst.w, dst.h), src);
-							pages[page].set_pixels(RectI(dst.x, dst.y - padding, dst.w, dst.h), src);
-							pages[page].set_pixels(RectI(dst.x, dst.y + padding, dst.w, dst.h), src);
-						}
+			// doesn't fit
+			if (node == nullptr)
+				break;
 
-						pages[page].set_pixels(dst, src);
+			// add
+			node->used = true;
+			node->down = nodes[index++].Reset(RectI(node->rect.x, node->rect.y + h, node->rect.w, node->rect.h - h));
+			node->right = nodes[index++].Reset(RectI(node->rect.x + w, node->rect.y, node->rect.w - w, h));
 
-					}
-				}
+			sources[packed]->packed.x = node->rect.x + padding;
+			sources[packed]->packed.y = node->rect.y + padding;
+			sources[packed]->page = page;
+			packed++;
+		}
+
+		page_sizes.push_back(calc_page_size(root->rect.w, root->rect.h, power_of_two));
+		page++;
+	}
+}
+
+bool Packer::pack_rects(Vector<Entry*>& sources, Vector<Point>& page_sizes)
+{
+	Vector<Entry*> remaining;
+	Vector<Entry*> next;
+	Vector<Placement> placements;
+
+	for (auto& it : sources)
+		if (!it->empty)
+			remaining.push_back(it);
+
+	while (remaining.size() > 0)
+	{
+		// start with a bin that could just about hold everything that's left, and double it until
+		// everything fits or we hit the max size. whatever doesn't fit goes on to the next page.
+		int64_t area = 0;
+		int largest = 0;
+		for (auto& it : remaining)
+		{
+			int w = it->packed.w + padding * 2 + spacing;
+			int h = it->packed.h + padding * 2 + spacing;
+			area += (int64_t)w * h;
+			largest = std::max(largest, std::max(w, h));
+		}
+
+		int size = 2;
+		while (size < max_size && (size < largest || (int64_t)size * size < area))
+			size *= 2;
+		size = std::min(size, max_size);
+
+		int placed, used_w, used_h;
+		while (true)
+		{
+			placed = place_rects(algorithm, size, size, remaining, allow_rotation, padding * 2 + spacing, placements, &used_w, &used_h);
+			if (placed >= remaining.size() || size >= max_size)
+				break;
+			size = std::min(size * 2, max_size);
+		}
+
+		// nothing fits on an empty page, so more pages won't help
+		if (placed <= 0)
+		{
+			BLAH_ERROR("Source image is larger than max atlas size");
+			return false;
+		}
+
+		int page = page_sizes.size();
+		page_sizes.push_back(calc_page_size(used_w, used_h, power_of_two));
+
+		next.clear();
+		for (int i = 0; i < remaining.size(); i++)
+		{
+			auto entry = remaining[i];
+			auto& placement = placements[i];
+
+			if (!placement.placed)
+			{
+				next.push_back(entry);
+				continue;
 			}
 
-			page++;
+			if (placement.rotated)
+				std::swap(entry->packed.w, entry->packed.h);
+
+			entry->page = page;
+			entry->rotated = placement.rotated;
+			entry->packed.x = placement.x + padding;
+			entry->packed.y = placement.y + padding;
+		}
+
+		std::swap(remaining, next);
+	}
+
+	return true;
+}
+
+bool Packer::same_pixels(int index, const Color* pixels, int stride, const RectI& bounds) const
+{
+	if (index < 0 || index >= entries.size())
+		return false;
+
+	auto& it = entries[index];
+	if (it.empty || it.reserved)
+		return false;
+
+	int w = (it.rotated ? it.packed.h : it.packed.w);
+	int h = (it.rotated ? it.packed.w : it.packed.h);
+	if (w != bounds.w || h != bounds.h)
+		return false;
+
+	const Color* base;
+	int base_stride;
+	bool rotated;
+	if (!source_pixels(it, &base, &base_stride, &rotated))
+		return false;
+
+	Vector<Color> row;
+	row.resize(w);
+
+	for (int y = 0; y < h; y++)
+	{
+		auto a = source_row(base, base_stride, rotated, w, h, y, row.data());
+		auto b = pixels + bounds.x + (int64_t)(bounds.y + y) * stride;
+		if (memcmp(a, b, sizeof(Color) * w) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+float Packer::occupancy(int page) const
+{
+	if (page < 0 || page >= pages.size() || pages[page].width <= 0 || pages[page].height <= 0)
+		return 0;
+
+	int64_t used = 0;
+	for (auto& it : entries)
+		if (!it.empty && it.page == page)
+			used += (int64_t)it.packed.w * it.packed.h;
+
+	return (float)((double)used / ((int64_t)pages[page].width * pages[page].height));
+}
+
+namespace
+{
+	constexpr char cache_magic[8] = { 'B', 'L', 'A', 'H', 'P', 'A', 'C', 'K' };
+	constexpr uint32_t cache_version = 1;
+
+	// hashes 8 bytes at a time, since this runs over every source pixel
+	uint64_t hash_bytes(uint64_t hash, const void* data, int64_t length)
+	{
+		auto bytes = (const uint8_t*)data;
+
+		for (; length >= 8; length -= 8, bytes += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes, 8);
+			hash = (hash ^ word) * 0x100000001b3ULL;
+			hash ^= hash >> 29;
+		}
+
+		for (; length > 0; length--, bytes++)
+			hash = (hash ^ *bytes) * 0x100000001b3ULL;
+
+		return hash;
+	}
+}
+
+uint64_t Packer::hash() const
+{
+	uint64_t hash = calc_settings();
+	Vector<Color> row;
+
+	for (auto& it : entries)
+	{
+		int32_t values[6] = { it.frame.x, it.frame.y, it.frame.w, it.frame.h, it.empty ? 1 : 0, it.reserved ? 1 : 0 };
+		hash = hash_bytes(hash, &it.id, sizeof(it.id));
+		hash = hash_bytes(hash, values, sizeof(values));
+
+		if (it.empty || it.reserved)
+			continue;
+
+		const Color* base;
+		int stride;
+		bool rotated;
+		if (!source_pixels(it, &base, &stride, &rotated))
+			continue;
+
+		int w = (it.rotated ? it.packed.h : it.packed.w);
+		int h = (it.rotated ? it.packed.w : it.packed.h);
+		row.resize(w);
+
+		for (int y = 0; y < h; y++)
+			hash = hash_bytes(hash, source_row(base, stride, rotated, w, h, y, row.data()), sizeof(Color) * w);
+	}
+
+	return hash;
+}
+
+bool Packer::save_cache(Stream& stream, uint64_t key)
+{
+	if (!stream.is_writable())
+		return false;
+
+	pack();
+
+	// header
+	int64_t expected = 0;
+	int64_t written = stream.write(cache_magic, sizeof(cache_magic));
+	written += stream.write<uint32_t>(cache_version);
+	written += stream.write<uint64_t>(key);
+	written += stream.write<uint64_t>(calc_settings());
+	written += stream.write<uint32_t>(pages.size());
+	written += stream.write<uint32_t>(entries.size());
+	expected += sizeof(cache_magic) + 4 + 8 + 8 + 4 + 4;
+
+	// pages
+	for (auto& it : pages)
+	{
+		written += stream.write<int32_t>(it.width);
+		written += stream.write<int32_t>(it.height);
+		expected += 8;
+	}
+
+	// entries
+	for (auto& it : entries)
+	{
+		written += stream.write<uint64_t>(it.id);
+		written += stream.write<int32_t>(it.page);
+		written += stream.write<uint32_t>((it.empty ? 1 : 0) | (it.rotated ? 2 : 0) | (it.reserved ? 4 : 0));
+		written += stream.write<int32_t>(it.frame.x);
+		written += stream.write<int32_t>(it.frame.y);
+		written += stream.write<int32_t>(it.frame.w);
+		written += stream.write<int32_t>(it.frame.h);
+		written += stream.write<int32_t>(it.packed.x);
+		written += stream.write<int32_t>(it.packed.y);
+		written += stream.write<int32_t>(it.packed.w);
+		written += stream.write<int32_t>(it.packed.h);
+		expected += 48;
+	}
+
+	// pixels, stored as-is so they can be copied straight into the pages
+	for (auto& it : pages)
+	{
+		int64_t size = sizeof(Color) * (int64_t)it.width * it.height;
+		expected += size;
+
+		if (it.pixels != nullptr)
+		{
+			written += stream.write(it.pixels, size);
 		}
+		else
+		{
+			Vector<Color> row;
+			row.resize(it.width);
+			for (int y = 0; y < it.height; y++)
+				written += stream.write(row.data(), sizeof(Color) * it.width);
+		}
+	}
+
+	return written == expected;
+}
+
+bool Packer::load_cache(Stream& stream, uint64_t key)
+{
+	if (!stream.is_readable())
+		return false;
+
+	// read the whole thing in at once
+	Vector<char> data;
+	{
+		int64_t length = stream.length() - stream.position();
+		if (length < (int64_t)sizeof(cache_magic) + 28)
+			return false;
+
+		data.resize(length);
+		if (stream.read(data.data(), length) != length)
+			return false;
+	}
+
+	MemoryStream reader(data.data(), data.size());
+
+	char magic[sizeof(cache_magic)];
+	reader.read(magic, sizeof(magic));
+	if (memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+		reader.read<uint32_t>() != cache_version ||
+		reader.read<uint64_t>() != key ||
+		reader.read<uint64_t>() != calc_settings())
+		return false;
+
+	int64_t page_count = reader.read<uint32_t>();
+	int64_t entry_count = reader.read<uint32_t>();
+	if (reader.length() - reader.position() < page_count * 8 + entry_count * 48)
+		return false;
+
+	Vector<Point> page_sizes;
+	int64_t pixels_size = 0;
+	for (int64_t i = 0; i < page_count; i++)
+	{
+		Point size;
+		size.x = reader.read<int32_t>();
+		size.y = reader.read<int32_t>();
+		if (size.x <= 0 || size.y <= 0 || size.x > max_size || size.y > max_size)
+			return false;
+
+		page_sizes.push_back(size);
+		pixels_size += sizeof(Color) * (int64_t)size.x * size.y;
 	}
+
+	if (reader.length() - reader.position() != entry_count * 48 + pixels_size)
+		return false;
+
+	Vector<Entry> loaded;
+	for (int64_t i = 0; i < entry_count; i++)
+	{
+		loaded.push_back(Entry(0, RectI()));
+
+		Entry& it = loaded.back();
+		it.id = reader.read<uint64_t>();
+		it.page = reader.read<int32_t>();
+
+		uint32_t flags = reader.read<uint32_t>();
+		it.empty = (flags & 1) != 0;
+		it.rotated = (flags & 2) != 0;
+		it.reserved = (flags & 4) != 0;
+
+		it.frame.x = reader.read<int32_t>();
+		it.frame.y = reader.read<int32_t>();
+		it.frame.w = reader.read<int32_t>();
+		it.frame.h = reader.read<int32_t>();
+		it.packed.x = reader.read<int32_t>();
+		it.packed.y = reader.read<int32_t>();
+		it.packed.w = reader.read<int32_t>();
+		it.packed.h = reader.read<int32_t>();
+
+		if (it.empty)
+			continue;
+
+		if (it.page < 0 || it.page >= page_count ||
+			it.packed.w <= 0 || it.packed.h <= 0 || it.packed.x < 0 || it.packed.y < 0 ||
+			it.packed.x + it.packed.w > page_sizes[it.page].x ||
+			it.packed.y + it.packed.h > page_sizes[it.page].y)
+			return false;
+	}
+
+	// the cache is valid, so replace everything
+	// the source pixels are read back out of the pages if they're repacked later
+	clear();
+	entries = std::move(loaded);
+
+	for (auto& it : page_sizes)
+	{
+		Image* page = pages.expand();
+		*page = Image(it.x, it.y);
+		reader.read(page->pixels, sizeof(Color) * (int64_t)it.x * it.y);
+
+		Change change;
+		change.page = pages.size() - 1;
+		change.rect = RectI(0, 0, it.x, it.y);
+		changes.push_back(change);
+	}
+
+	m_dirty = false;
+	m_packed_count = entries.size();
+	m_packed_settings = calc_settings();
+	return true;
 }
 
 void Packer::clear()
 {
 	pages.clear();
 	entries.clear();
+	changes.clear();
+	m_free.clear();
+	m_packed_count = 0;
+	free_chunks();
 	m_dirty = false;
 }
 
@@ -300,7 +1400,10 @@ void Packer::dispose()
 {
 	pages.clear();
 	entries.clear();
-	m_buffer.close();
+	changes.clear();
+	m_free.clear();
+	m_packed_count = 0;
+	free_chunks();
 	max_size = 0;
 	power_of_two = 0;
 	spacing = 0;
@@ -0,0 +1,39 @@
+#pragma once
+#include <blah/graphics/capture.h>
+#include <blah/graphics/renderpass.h>
+
+namespace Blah
+{
+	// Hooks used by the graphics layer and the backends to feed the current capture.
+	// They all do nothing unless a capture is running.
+	namespace Capture
+	{
+		// Called by RenderPass::perform, after the pass has been validated
+		void on_render(const RenderPass& pass);
+
+		// Called when a FrameBuffer (or the Back Buffer) is cleared
+		void on_clear(const FrameBuffer* framebuffer, Color color, float depth, uint8_t stencil, ClearMask mask);
+
+		// Called when a Mesh uploads its index buffer
+		void on_index_data(const Mesh* mesh, IndexFormat format, const void* indices, int64_t count);
+
+		// Called when a Mesh uploads its vertex buffer
+		void on_vertex_data(const Mesh* mesh, const VertexFormat& format, const void* vertices, int64_t count);
+
+		// Called when a Mesh uploads its instance buffer
+		void on_instance_data(const Mesh* mesh, const VertexFormat& format, const void* instances, int64_t count);
+
+		// Called when a Texture's contents are set
+		void on_texture_data(const Texture* texture, const unsigned char* data);
+
+		// Called after a region of a Texture's contents is set. `bounds` is the region clipped to the
+		// Texture, and `data` points at its first pixel, in rows that are `stride` pixels apart.
+		void on_texture_region(const Texture* texture, const RectI& bounds, const unsigned char* data, int stride);
+
+		// Called when a graphics resource is destroyed
+		void on_destroyed(const void* resource);
+
+		// Called by the Application at the end of every frame
+		void on_frame();
+	}
+}
@@ -7,6 +7,7 @@
 #include <blah/graphics/mesh.h>
 #include <blah/graphics/material.h>
 #include <blah/math/color.h>
+#include <blah/math/rectI.h>
 
 namespace Blah
 {
@@ -56,5 +57,40 @@ namespace Blah
 		// Creates a new Mesh.
 		// if the Mesh is invalid, this should return an empty reference.
 		MeshRef create_mesh();
+
+		// Gets the number of bytes per pixel of a Texture Format
+		inline int bytes_per_pixel(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::R: return 1;
+			case TextureFormat::RG: return 2;
+			case TextureFormat::RGBA: return 4;
+			case TextureFormat::DepthStencil: return 4;
+			default: return 0;
+			}
+		}
+
+		// Gets the number of bytes in a Texture of the given size and format
+		inline int64_t texture_size(int width, int height, TextureFormat format)
+		{
+			return (int64_t)width * height * bytes_per_pixel(format);
+		}
+
+		// Clips a region of a Texture to its bounds
+		inline RectI clip_region(const RectI& rect, int width, int height)
+		{
+			int left = (rect.x > 0 ? rect.x : 0);
+			int top = (rect.y > 0 ? rect.y : 0);
+			int right = (rect.x + rect.w < width ? rect.x + rect.w : width);
+			int bottom = (rect.y + rect.h < height ? rect.y + rect.h : height);
+			return RectI(left, top, right - left, bottom - top);
+		}
+
+		// Gets the offset, in bytes, of the clipped region within the pixel buffer of the whole region
+		inline int64_t region_offset(const RectI& rect, const RectI& clipped, TextureFormat format)
+		{
+			return ((int64_t)(clipped.y - rect.y) * rect.w + (clipped.x - rect.x)) * bytes_per_pixel(format);
+		}
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "../internal/graphics_backend.h"
 #include "../internal/platform_backend.h"
+#include "../internal/capture.h"
 #include <blah/core/log.h>
 #include <stdio.h>
 #include <string.h>
@@ -113,9 +114,14 @@ namespace Blah
 			m_is_framebuffer = is_framebuffer;
 			m_size = 0;
 
+			create_resources();
+		}
+
+		void create_resources()
+		{
 			D3D11_TEXTURE2D_DESC desc = { 0 };
-			desc.Width = width;
-			desc.Height = height;
+			desc.Width = m_width;
+			desc.Height = m_height;
 			desc.MipLevels = 1;
 			desc.ArraySize = 1;
 			desc.SampleDesc.Count = 1;
@@ -126,23 +132,23 @@ namespace Blah
 
 			bool is_depth_stencil = false;
 
-			switch (format)
+			switch (m_format)
 			{
 			case TextureFormat::R:
 				desc.Format = DXGI_FORMAT_R8_UNORM;
-				m_size = width * height;
+				m_size = m_width * m_height;
 				break;
 			case TextureFormat::RG:
 				desc.Format = DXGI_FORMAT_R8G8_UNORM;
-				m_size = width * height * 2;
+				m_size = m_width * m_height * 2;
 				break;
 			case TextureFormat::RGBA:
 				desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-				m_size = width * height * 4;
+				m_size = m_width * m_height * 4;
 				break;
 			case TextureFormat::DepthStencil:
 				desc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-				m_size = width * height * 4;
+				m_size = m_width * m_height * 4;
 				is_depth_stencil = true;
 				break;
 			}
@@ -152,7 +158,7 @@ namespace Blah
 			else
 				desc.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
 
-			if (is_framebuffer && !is_depth_stencil)
+			if (m_is_framebuffer && !is_depth_stencil)
 				desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
 
 			m_dxgi_format = desc.Format;
@@ -207,6 +213,16 @@ namespace Blah
 
 		virtual void set_data(unsigned char* data) override
 		{
+			Capture::on_texture_data(this, data);
+
+			// re-allocate if we were evicted
+			if (!texture)
+			{
+				create_resources();
+				if (!texture)
+					return;
+			}
+
 			// bounds
 			D3D11_BOX box;
 			box.left = 0;
@@ -226,10 +242,46 @@ namespace Blah
 				0);
 		}
 
+		virtual void set_data(const RectI& rect, unsigned char* data) override
+		{
+			RectI bounds = GraphicsBackend::clip_region(rect, m_width, m_height);
+			if (bounds.w <= 0 || bounds.h <= 0)
+				return;
+
+			// re-allocate if we were evicted
+			if (!texture)
+			{
+				create_resources();
+				if (!texture)
+					return;
+			}
+
+			D3D11_BOX box;
+			box.left = bounds.x;
+			box.right = bounds.x + bounds.w;
+			box.top = bounds.y;
+			box.bottom = bounds.y + bounds.h;
+			box.front = 0;
+			box.back = 1;
+
+			state.context->UpdateSubresource(
+				texture,
+				0,
+				&box,
+				data + GraphicsBackend::region_offset(rect, bounds, m_format),
+				rect.w * GraphicsBackend::bytes_per_pixel(m_format),
+				0);
+
+			Capture::on_texture_region(this, bounds, data + GraphicsBackend::region_offset(rect, bounds, m_format), rect.w);
+		}
+
 		virtual void get_data(unsigned char* data) override
 		{
 			HRESULT hr;
 
+			if (!texture)
+				return;
+
 			// create staging texture
 			if (!staging)
 			{
@@ -280,6 +332,27 @@ namespace Blah
 			return m_is_framebuffer;
 		}
 
+		virtual void evict() override
+		{
+			if (m_is_framebuffer)
+				return;
+
+			if (texture)
+				texture->Release();
+			if (staging)
+				staging->Release();
+			if (view)
+				view->Release();
+			staging = nullptr;
+			texture = nullptr;
+			view = nullptr;
+		}
+
+		virtual bool is_resident() const override
+		{
+			return texture != nullptr;
+		}
+
 	};
 
 	class D3D11_FrameBuffer : public FrameBuffer
@@ -351,6 +424,8 @@ namespace Blah
 
 		virtual void clear(Color color, float depth, uint8_t stencil, ClearMask mask) override
 		{
+			Capture::on_clear(this, color, depth, stencil, mask);
+
 			float col[4] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
 
 			if (((int)mask & (int)ClearMask::Color) == (int)ClearMask::Color)
@@ -569,6 +644,8 @@ namespace Blah
 
 		virtual void index_data(IndexFormat format, const void* indices, int64_t count) override
 		{
+			Capture::on_index_data(this, format, indices, count);
+
 			m_index_count = count;
 
 			if (index_format != format || !index_buffer || m_index_count > m_index_capacity)
@@ -623,6 +700,8 @@ namespace Blah
 
 		virtual void vertex_data(const VertexFormat& format, const void* vertices, int64_t count) override
 		{
+			Capture::on_vertex_data(this, format, vertices, count);
+
 			m_vertex_count = count;
 
 			// recreate buffer if we've changed
@@ -671,6 +750,8 @@ namespace Blah
 
 		virtual void instance_data(const VertexFormat& format, const void* instances, int64_t count) override
 		{
+			Capture::on_instance_data(this, format, instances, count);
+
 
 		}
 
@@ -750,6 +831,7 @@ namespace Blah
 		state.features.instancing = true;
 		state.features.max_texture_size = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
 		state.features.origin_bottom_left = false;
+		state.features.red_swizzle = false;
 
 		// Print Driver Info
 		{
@@ -2,6 +2,7 @@
 
 #include "../internal/graphics_backend.h"
 #include "../internal/platform_backend.h"
+#include "../internal/capture.h"
 #include <blah/core/log.h>
 
 namespace Blah
@@ -13,6 +14,7 @@ namespace Blah
 		int m_height;
 		TextureFormat m_format;
 		bool m_framebuffer;
+		bool m_resident;
 
 	public:
 
@@ -22,6 +24,7 @@ namespace Blah
 			m_height = height;
 			m_format = format;
 			m_framebuffer = framebuffer;
+			m_resident = true;
 		}
 
 		virtual int width() const override
@@ -41,7 +44,18 @@ namespace Blah
 
 		virtual void set_data(unsigned char* data) override
 		{
+			Capture::on_texture_data(this, data);
 
+			m_resident = true;
+		}
+
+		virtual void set_data(const RectI& rect, unsigned char* data) override
+		{
+			m_resident = true;
+
+			RectI bounds = GraphicsBackend::clip_region(rect, m_width, m_height);
+			if (bounds.w > 0 && bounds.h > 0)
+				Capture::on_texture_region(this, bounds, data + GraphicsBackend::region_offset(rect, bounds, m_format), rect.w);
 		}
 
 		virtual void get_data(unsigned char* data) override
@@ -54,6 +68,17 @@ namespace Blah
 			return m_framebuffer;
 		}
 
+		virtual void evict() override
+		{
+			if (!m_framebuffer)
+				m_resident = false;
+		}
+
+		virtual bool is_resident() const override
+		{
+			return m_resident;
+		}
+
 	};
 
 	class Dummy_FrameBuffer : public FrameBuffer
@@ -103,9 +128,9 @@ namespace Blah
 			return m_attachments[0]->height();
 		}
 
-		virtual void clear(Color color) override
+		virtual void clear(Color color, float depth, uint8_t stencil, ClearMask mask) override
 		{
-
+			Capture::on_clear(this, color, depth, stencil, mask);
 		}
 	};
 
@@ -146,16 +171,22 @@ namespace Blah
 
 		virtual void index_data(IndexFormat format, const void* indices, int64_t count) override
 		{
+			Capture::on_index_data(this, format, indices, count);
+
 			m_index_count = count;
 		}
 
 		virtual void vertex_data(const VertexFormat& format, const void* vertices, int64_t count) override
 		{
+			Capture::on_vertex_data(this, format, vertices, count);
+
 			m_vertex_count = count;
 		}
 
 		virtual void instance_data(const VertexFormat& format, const void* instances, int64_t count) override
 		{
+			Capture::on_instance_data(this, format, instances, count);
+
 			m_instance_count = count;
 		}
 
@@ -193,7 +224,7 @@ namespace Blah
 
 	const RendererFeatures& GraphicsBackend::features()
 	{
-		static const RendererFeatures features { false, true, 4096 };
+		static const RendererFeatures features { false, true, 4096, true };
 		return features;
 	}
 
@@ -226,7 +257,7 @@ namespace Blah
 
 	}
 
-	void GraphicsBackend::clear_backbuffer(Color color)
+	void GraphicsBackend::clear_backbuffer(Color color, float depth, uint8_t stencil, ClearMask mask)
 	{
 
 	}
@@ -2,6 +2,7 @@
 
 #include "../internal/graphics_backend.h"
 #include "../internal/platform_backend.h"
+#include "../internal/capture.h"
 #include <blah/core/log.h>
 #include <stdio.h>
 #include <string.h>
@@ -163,8 +164,13 @@ typedef char			GLchar;
 #define GL_TEXTURE_BASE_LEVEL 0x813C
 #define GL_TEXTURE_MAX_LEVEL 0x813D
 #define GL_TEXTURE_LOD_BIAS 0x8501
+#define GL_TEXTURE_SWIZZLE_R 0x8E42
+#define GL_TEXTURE_SWIZZLE_G 0x8E43
+#define GL_TEXTURE_SWIZZLE_B 0x8E44
+#define GL_TEXTURE_SWIZZLE_A 0x8E45
 #define GL_PACK_ALIGNMENT 0x0D05
 #define GL_UNPACK_ALIGNMENT 0x0CF5
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
 #define GL_TEXTURE0 0x84C0
 #define GL_MAX_TEXTURE_IMAGE_UNITS 0x8872
 #define GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS 0x8B4C
@@ -254,9 +260,14 @@ typedef char			GLchar;
 	GL_FUNC(BindRenderbuffer, void, GLenum target, GLuint id) \
 	GL_FUNC(BindFramebuffer, void, GLenum target, GLuint id) \
 	GL_FUNC(TexImage2D, void, GLenum target, GLint level, GLenum internalFormat, GLint width, GLint height, GLint border, GLenum format, GLenum type, void* data) \
+	GL_FUNC(TexSubImage2D, void, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint width, GLint height, GLenum format, GLenum type, const void* data) \
 	GL_FUNC(FramebufferRenderbuffer, void, GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) \
 	GL_FUNC(FramebufferTexture2D, void, GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) \
 	GL_FUNC(TexParameteri, void, GLenum target, GLenum name, GLint param) \
+	GL_FUNC(GenSamplers, void, GLint n, GLuint* samplers) \
+	GL_FUNC(DeleteSamplers, void, GLint n, GLuint* samplers) \
+	GL_FUNC(BindSampler, void, GLuint unit, GLuint sampler) \
+	GL_FUNC(SamplerParameteri, void, GLuint sampler, GLenum name, GLint param) \
 	GL_FUNC(RenderbufferStorage, void, GLenum target, GLenum internalformat, GLint width, GLint height) \
 	GL_FUNC(GetTexImage, void, GLenum target, GLint level, GLenum format, GLenum type, void* data) \
 	GL_FUNC(DrawElements, void, GLenum mode, GLint count, GLenum type, void* indices) \
@@ -350,6 +361,17 @@ namespace Blah
 		// state
 		void* context;
 
+		struct StoredSampler
+		{
+			TextureSampler sampler;
+			GLuint id;
+		};
+
+		// sampler objects, one for each unique TextureSampler
+		Vector<StoredSampler> sampler_cache;
+
+		GLuint get_sampler(const TextureSampler& sampler);
+
 		// info
 		int max_color_attachments;
 		int max_element_indices;
@@ -544,7 +566,6 @@ namespace Blah
 		GLuint m_id;
 		int m_width;
 		int m_height;
-		TextureSampler m_sampler;
 		TextureFormat m_format;
 		GLenum m_gl_internal_format;
 		GLenum m_gl_format;
@@ -558,7 +579,6 @@ namespace Blah
 			m_id = 0;
 			m_width = width;
 			m_height = height;
-			m_sampler = TextureSampler(TextureFilter::None, TextureWrap::None, TextureWrap::None);
 			m_format = format;
 			framebuffer_parent = false;
 			m_gl_internal_format = GL_RED;
@@ -605,6 +625,15 @@ namespace Blah
 			gl.ActiveTexture(GL_TEXTURE0);
 			gl.BindTexture(GL_TEXTURE_2D, m_id);
 			gl.TexImage2D(GL_TEXTURE_2D, 0, m_gl_internal_format, width, height, 0, m_gl_format, m_gl_type, nullptr);
+
+			// single-channel textures hold coverage, so they're sampled as (r, r, r, r)
+			if (format == TextureFormat::R)
+			{
+				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
+				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_RED);
+			}
 		}
 
 		~OpenGL_Texture()
@@ -633,29 +662,49 @@ namespace Blah
 			return m_format;
 		}
 
-		void update_sampler(const TextureSampler& sampler)
+		virtual void set_data(unsigned char* data) override
 		{
-			if (m_sampler != sampler)
-			{
-				m_sampler = sampler;
+			Capture::on_texture_data(this, data);
 
-				gl.BindTexture(GL_TEXTURE_2D, m_id);
-				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (m_sampler.filter == TextureFilter::Nearest ? GL_NEAREST : GL_LINEAR));
-				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (m_sampler.filter == TextureFilter::Nearest ? GL_NEAREST : GL_LINEAR));
-				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (m_sampler.wrap_x == TextureWrap::Clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT));
-				gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (m_sampler.wrap_y == TextureWrap::Clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT));
-			}
+			// re-allocate if we were evicted
+			if (m_id == 0)
+				gl.GenTextures(1, &m_id);
+
+			gl.ActiveTexture(GL_TEXTURE0);
+			gl.BindTexture(GL_TEXTURE_2D, m_id);
+			gl.TexImage2D(GL_TEXTURE_2D, 0, m_gl_internal_format, m_width, m_height, 0, m_gl_format, m_gl_type, data);
 		}
 
-		virtual void set_data(unsigned char* data) override
+		virtual void set_data(const RectI& rect, unsigned char* data) override
 		{
+			RectI bounds = GraphicsBackend::clip_region(rect, m_width, m_height);
+			if (bounds.w <= 0 || bounds.h <= 0)
+				return;
+
+			// re-allocate if we were evicted
+			if (m_id == 0)
+			{
+				gl.GenTextures(1, &m_id);
+				gl.ActiveTexture(GL_TEXTURE0);
+				gl.BindTexture(GL_TEXTURE_2D, m_id);
+				gl.TexImage2D(GL_TEXTURE_2D, 0, m_gl_internal_format, m_width, m_height, 0, m_gl_format, m_gl_type, nullptr);
+			}
+
 			gl.ActiveTexture(GL_TEXTURE0);
 			gl.BindTexture(GL_TEXTURE_2D, m_id);
-			gl.TexImage2D(GL_TEXTURE_2D, 0, m_gl_internal_format, m_width, m_height, 0, m_gl_format, m_gl_type, data);
+			gl.PixelStorei(GL_UNPACK_ROW_LENGTH, rect.w);
+			gl.TexSubImage2D(GL_TEXTURE_2D, 0, bounds.x, bounds.y, bounds.w, bounds.h, m_gl_format, m_gl_type,
+				data + GraphicsBackend::region_offset(rect, bounds, m_format));
+			gl.PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+			Capture::on_texture_region(this, bounds, data + GraphicsBackend::region_offset(rect, bounds, m_format), rect.w);
 		}
 
 		virtual void get_data(unsigned char* data) override
 		{
+			if (m_id == 0)
+				return;
+
 			gl.ActiveTexture(GL_TEXTURE0);
 			gl.BindTexture(GL_TEXTURE_2D, m_id);
 			gl.GetTexImage(GL_TEXTURE_2D, 0, m_gl_internal_format, m_gl_type, data);
@@ -666,6 +715,20 @@ namespace Blah
 			return framebuffer_parent;
 		}
 
+		virtual void evict() override
+		{
+			if (m_id > 0 && !framebuffer_parent)
+			{
+				gl.DeleteTextures(1, &m_id);
+				m_id = 0;
+			}
+		}
+
+		virtual bool is_resident() const override
+		{
+			return m_id > 0;
+		}
+
 	};
 
 	class OpenGL_FrameBuffer : public FrameBuffer
@@ -751,6 +814,8 @@ namespace Blah
 
 		virtual void clear(Color color, float depth, uint8_t stencil, ClearMask mask) override
 		{
+			Capture::on_clear(this, color, depth, stencil, mask);
+
 			int clear = 0;
 
 			if (((int)mask & (int)ClearMask::Color) == (int)ClearMask::Color)
@@ -1028,6 +1093,8 @@ namespace Blah
 
 		virtual void index_data(IndexFormat format, const void* indices, int64_t count) override
 		{
+			Capture::on_index_data(this, format, indices, count);
+
 			m_index_count = count;
 
 			gl.BindVertexArray(m_id);
@@ -1055,6 +1122,8 @@ namespace Blah
 
 		virtual void vertex_data(const VertexFormat& format, const void* vertices, int64_t count) override
 		{
+			Capture::on_vertex_data(this, format, vertices, count);
+
 			m_vertex_count = count;
 
 			gl.BindVertexArray(m_id);
@@ -1076,6 +1145,8 @@ namespace Blah
 
 		virtual void instance_data(const VertexFormat& format, const void* instances, int64_t count) override
 		{
+			Capture::on_instance_data(this, format, instances, count);
+
 			m_instance_count = count;
 
 			gl.BindVertexArray(m_id);
@@ -1158,6 +1229,7 @@ namespace Blah
 		// assign info
 		gl.features.instancing = true;
 		gl.features.origin_bottom_left = true;
+		gl.features.red_swizzle = true;
 		gl.features.max_texture_size = gl.max_texture_size;
 
 		return true;
@@ -1170,6 +1242,11 @@ namespace Blah
 
 	void GraphicsBackend::shutdown()
 	{
+		// release cached objects
+		for (auto& it : gl.sampler_cache)
+			gl.DeleteSamplers(1, &it.id);
+		gl.sampler_cache.clear();
+
 		PlatformBackend::gl_context_destroy(gl.context);
 		gl.context = nullptr;
 	}
@@ -1295,10 +1372,11 @@ namespace Blah
 						else
 						{
 							auto gl_tex = ((OpenGL_Texture*)tex.get());
-							gl_tex->update_sampler(sampler);
 							gl.BindTexture(GL_TEXTURE_2D, gl_tex->gl_id());
 						}
 
+						gl.BindSampler(gl_texture_slot, gl.get_sampler(sampler));
+
 						texture_ids[n] = gl_texture_slot;
 						gl_texture_slot++;
 					}
@@ -1496,6 +1574,25 @@ namespace Blah
 		}
 	}
 
+	GLuint State::get_sampler(const TextureSampler& sampler)
+	{
+		for (auto& it : sampler_cache)
+			if (it.sampler == sampler)
+				return it.id;
+
+		GLuint id = 0;
+		gl.GenSamplers(1, &id);
+		gl.SamplerParameteri(id, GL_TEXTURE_MIN_FILTER, (sampler.filter == TextureFilter::Nearest ? GL_NEAREST : GL_LINEAR));
+		gl.SamplerParameteri(id, GL_TEXTURE_MAG_FILTER, (sampler.filter == TextureFilter::Nearest ? GL_NEAREST : GL_LINEAR));
+		gl.SamplerParameteri(id, GL_TEXTURE_WRAP_S, (sampler.wrap_x == TextureWrap::Clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT));
+		gl.SamplerParameteri(id, GL_TEXTURE_WRAP_T, (sampler.wrap_y == TextureWrap::Clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT));
+
+		auto entry = sampler_cache.expand();
+		entry->sampler = sampler;
+		entry->id = id;
+		return id;
+	}
+
 	void GraphicsBackend::clear_backbuffer(Color color, float depth, uint8_t stencil, ClearMask mask)
 	{
 		int clear = 0;
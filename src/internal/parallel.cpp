@@ -0,0 +1,147 @@
+#include "parallel.h"
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define BLAH_PARALLEL_DISABLED
+#endif
+
+using namespace Blah;
+
+namespace
+{
+	thread_local bool in_job = false;
+
+	struct Batch
+	{
+		const std::function<void(int)>* job;
+		int count;
+		std::atomic<int> next;
+
+		void run()
+		{
+			in_job = true;
+			for (int i = next++; i < count; i = next++)
+				(*job)(i);
+			in_job = false;
+		}
+	};
+
+	struct Pool
+	{
+		std::vector<std::thread> workers;
+		std::mutex busy;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+
+		// the batch currently being run, and how many workers are helping with it
+		Batch* current = nullptr;
+		uint64_t batch = 0;
+		int active = 0;
+		bool stopping = false;
+
+		Pool()
+		{
+#ifndef BLAH_PARALLEL_DISABLED
+			int threads = (int)std::thread::hardware_concurrency();
+			for (int i = 1; i < threads; i++)
+				workers.emplace_back([this]() { work(); });
+#endif
+		}
+
+		~Pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+
+			wake.notify_all();
+			for (auto& it : workers)
+				it.join();
+		}
+
+		void work()
+		{
+			uint64_t last = 0;
+
+			while (true)
+			{
+				Batch* running = nullptr;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&]() { return stopping || (current != nullptr && batch != last); });
+					if (stopping)
+						return;
+					last = batch;
+					running = current;
+					active++;
+				}
+
+				running->run();
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					active--;
+				}
+				done.notify_one();
+			}
+		}
+	};
+
+	Pool& pool()
+	{
+		static Pool instance;
+		return instance;
+	}
+}
+
+int Parallel::thread_count()
+{
+	return (int)pool().workers.size() + 1;
+}
+
+void Parallel::for_each(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)
+		return;
+
+	auto& p = pool();
+
+	// run on this thread if there's nothing to gain from the workers
+	if (count == 1 || p.workers.size() <= 0 || in_job || !p.busy.try_lock())
+	{
+		for (int i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	Batch batch;
+	batch.job = &job;
+	batch.count = count;
+	batch.next = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(p.mutex);
+		p.current = &batch;
+		p.batch++;
+	}
+
+	p.wake.notify_all();
+	batch.run();
+
+	// wait for the workers to finish the jobs they've taken
+	{
+		std::unique_lock<std::mutex> lock(p.mutex);
+		p.done.wait(lock, [&]() { return p.active <= 0; });
+		p.current = nullptr;
+	}
+
+	p.busy.unlock();
+}
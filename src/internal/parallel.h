@@ -0,0 +1,18 @@
+#pragma once
+#include <functional>
+
+namespace Blah
+{
+	// A small pool of worker threads, shared by anything in Blah that can split its work up.
+	// The workers are created the first time they're needed.
+	namespace Parallel
+	{
+		// Returns the number of threads that run jobs, including the calling thread
+		int thread_count();
+
+		// Calls `job` once for every index in [0, count), spread across the worker threads,
+		// and returns once they've all finished. Calls made from inside a job, or while
+		// another thread is already running jobs, run on the calling thread instead.
+		void for_each(int count, const std::function<void(int)>& job);
+	}
+}
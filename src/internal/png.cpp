@@ -0,0 +1,637 @@
+#include "png.h"
+#include "parallel.h"
+#include <blah/streams/stream.h>
+#include <blah/containers/vector.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace Blah;
+
+namespace
+{
+	// Rows are grouped into bands of roughly this many bytes, which are compressed in parallel
+	constexpr int64_t band_bytes = 256 * 1024;
+
+	// LZ77 settings
+	constexpr int window_size = 32768;
+	constexpr int hash_bits = 15;
+	constexpr int max_chain = 48;
+	constexpr int nice_length = 128;
+	constexpr int min_match = 3;
+	constexpr int max_match = 258;
+
+	constexpr int bpp = 4;
+
+	// ---------------------------------------------------------------------------------
+	// Filtering
+
+	inline uint8_t paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = p > a ? p - a : a - p;
+		int pb = p > b ? p - b : b - p;
+		int pc = p > c ? p - c : c - p;
+		if (pa <= pb && pa <= pc)
+			return (uint8_t)a;
+		if (pb <= pc)
+			return (uint8_t)b;
+		return (uint8_t)c;
+	}
+
+	// Scores a filtered row by the sum of its bytes as signed values, the heuristic from the PNG spec
+	uint64_t score(const uint8_t* row, int length)
+	{
+		uint64_t sum = 0;
+		int i = 0;
+
+#ifdef PNG_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		__m128i total = zero;
+
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+			__m128i abs = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+			total = _mm_add_epi64(total, _mm_sad_epu8(abs, zero));
+		}
+
+		sum = (uint64_t)_mm_cvtsi128_si32(total) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#endif
+
+		for (; i < length; i++)
+			sum += (row[i] < 128 ? row[i] : 256 - row[i]);
+
+		return sum;
+	}
+
+	// Writes all 4 filters of a row (Sub, Up, Average, Paeth) into `out`, `length` bytes apart
+	void filter_candidates(const uint8_t* row, const uint8_t* up, int length, uint8_t* out)
+	{
+		uint8_t* sub = out;
+		uint8_t* upf = out + length;
+		uint8_t* avg = out + length * 2;
+		uint8_t* pth = out + length * 3;
+
+		// the first pixel has nothing to its left
+		for (int i = 0; i < bpp && i < length; i++)
+		{
+			sub[i] = row[i];
+			upf[i] = (uint8_t)(row[i] - up[i]);
+			avg[i] = (uint8_t)(row[i] - (up[i] >> 1));
+			pth[i] = (uint8_t)(row[i] - up[i]);
+		}
+
+		int i = bpp;
+
+#ifdef PNG_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi8(1);
+
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+			__m128i a = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+			__m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+			__m128i c = _mm_loadu_si128((const __m128i*)(up + i - bpp));
+
+			_mm_storeu_si128((__m128i*)(sub + i), _mm_sub_epi8(x, a));
+			_mm_storeu_si128((__m128i*)(upf + i), _mm_sub_epi8(x, b));
+
+			// floor((a + b) / 2), as _mm_avg_epu8 rounds up
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+			_mm_storeu_si128((__m128i*)(avg + i), _mm_sub_epi8(x, average));
+
+			// paeth, in 16-bit lanes
+			__m128i predicted[2];
+			for (int half = 0; half < 2; half++)
+			{
+				__m128i a16 = half == 0 ? _mm_unpacklo_epi8(a, zero) : _mm_unpackhi_epi8(a, zero);
+				__m128i b16 = half == 0 ? _mm_unpacklo_epi8(b, zero) : _mm_unpackhi_epi8(b, zero);
+				__m128i c16 = half == 0 ? _mm_unpacklo_epi8(c, zero) : _mm_unpackhi_epi8(c, zero);
+
+				__m128i bc = _mm_sub_epi16(b16, c16);
+				__m128i ac = _mm_sub_epi16(a16, c16);
+				__m128i abc = _mm_add_epi16(bc, ac);
+				__m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+				__m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+				__m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+
+				__m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+				__m128i not_b = _mm_cmpgt_epi16(pb, pc);
+				__m128i b_or_c = _mm_or_si128(_mm_and_si128(not_b, c16), _mm_andnot_si128(not_b, b16));
+				predicted[half] = _mm_or_si128(_mm_and_si128(not_a, b_or_c), _mm_andnot_si128(not_a, a16));
+			}
+
+			__m128i prediction = _mm_packus_epi16(predicted[0], predicted[1]);
+			_mm_storeu_si128((__m128i*)(pth + i), _mm_sub_epi8(x, prediction));
+		}
+#endif
+
+		for (; i < length; i++)
+		{
+			sub[i] = (uint8_t)(row[i] - row[i - bpp]);
+			upf[i] = (uint8_t)(row[i] - up[i]);
+			avg[i] = (uint8_t)(row[i] - ((row[i - bpp] + up[i]) >> 1));
+			pth[i] = (uint8_t)(row[i] - paeth(row[i - bpp], up[i], up[i - bpp]));
+		}
+	}
+
+	// Filters a row into `out` (the filter type byte followed by the row), picking the filter that scores best
+	void filter_row(const uint8_t* row, const uint8_t* up, int length, uint8_t* out, uint8_t* scratch)
+	{
+		filter_candidates(row, up, length, scratch);
+
+		int best = 0;
+		uint64_t best_score = score(row, length);
+
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t s = score(scratch + (int64_t)length * i, length);
+			if (s < best_score)
+			{
+				best = i + 1;
+				best_score = s;
+			}
+		}
+
+		out[0] = (uint8_t)best;
+		memcpy(out + 1, best == 0 ? row : scratch + (int64_t)length * (best - 1), length);
+	}
+
+	// ---------------------------------------------------------------------------------
+	// Deflate, with fixed Huffman codes
+
+	const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	struct Tables
+	{
+		// bit-reversed fixed Huffman codes, since deflate writes them most significant bit first
+		uint16_t lit_code[288];
+		uint8_t lit_bits[288];
+		uint8_t dist_code[30];
+
+		uint8_t length_symbol[max_match + 1];
+		uint8_t dist_symbol_small[257];
+		uint8_t dist_symbol_large[256];
+
+		uint32_t crc[256];
+
+		static uint16_t reverse(uint16_t code, int bits)
+		{
+			uint16_t result = 0;
+			for (int i = 0; i < bits; i++)
+				result |= ((code >> i) & 1) << (bits - 1 - i);
+			return result;
+		}
+
+		Tables()
+		{
+			for (int i = 0; i < 288; i++)
+			{
+				if (i < 144)
+					lit_code[i] = reverse(0x30 + i, lit_bits[i] = 8);
+				else if (i < 256)
+					lit_code[i] = reverse(0x190 + i - 144, lit_bits[i] = 9);
+				else if (i < 280)
+					lit_code[i] = reverse(i - 256, lit_bits[i] = 7);
+				else
+					lit_code[i] = reverse(0xc0 + i - 280, lit_bits[i] = 8);
+			}
+
+			for (int i = 0; i < 30; i++)
+				dist_code[i] = (uint8_t)reverse(i, 5);
+
+			for (int i = 0; i < 29; i++)
+				for (int len = length_base[i]; len <= max_match && (i == 28 || len < length_base[i + 1]); len++)
+					length_symbol[len] = (uint8_t)i;
+
+			for (int i = 0; i < 30; i++)
+			{
+				for (int d = dist_base[i]; d < (i == 29 ? 32769 : dist_base[i + 1]); d++)
+				{
+					if (d <= 256)
+						dist_symbol_small[d] = (uint8_t)i;
+					else if (((d - 1) >> 7) < 256)
+						dist_symbol_large[(d - 1) >> 7] = (uint8_t)i;
+				}
+			}
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				crc[i] = c;
+			}
+		}
+
+		int dist_symbol(int dist) const
+		{
+			return dist <= 256 ? dist_symbol_small[dist] : dist_symbol_large[(dist - 1) >> 7];
+		}
+	};
+
+	const Tables& tables()
+	{
+		static Tables instance;
+		return instance;
+	}
+
+	struct BitWriter
+	{
+		uint8_t* out;
+		uint64_t bits = 0;
+		int count = 0;
+
+		void put(uint32_t value, int length)
+		{
+			bits |= (uint64_t)value << count;
+			count += length;
+
+			if (count >= 32)
+			{
+				out[0] = (uint8_t)bits;
+				out[1] = (uint8_t)(bits >> 8);
+				out[2] = (uint8_t)(bits >> 16);
+				out[3] = (uint8_t)(bits >> 24);
+				out += 4;
+				bits >>= 32;
+				count -= 32;
+			}
+		}
+
+		void align()
+		{
+			while (count > 0)
+			{
+				*out++ = (uint8_t)bits;
+				bits >>= 8;
+				count -= 8;
+			}
+
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	inline uint32_t hash3(const uint8_t* p)
+	{
+		uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+		return (v * 2654435761u) >> (32 - hash_bits);
+	}
+
+	inline int match_length(const uint8_t* a, const uint8_t* b, int limit)
+	{
+		int length = 0;
+
+		while (length + 8 <= limit)
+		{
+			uint64_t x, y;
+			memcpy(&x, a + length, 8);
+			memcpy(&y, b + length, 8);
+			if (x != y)
+				break;
+			length += 8;
+		}
+
+		while (length < limit && a[length] == b[length])
+			length++;
+
+		return length;
+	}
+
+	// Compresses data[start, end) as a single fixed Huffman block. Matches can reach back
+	// into the previous band, since the decoder will have already seen it.
+	// Non-final bands end with a sync flush, so the next band starts on a byte boundary.
+	void deflate_band(const uint8_t* data, int64_t total, int64_t start, int64_t end, bool last, Vector<uint8_t>& result)
+	{
+		const Tables& t = tables();
+
+		// worst case is every byte as a 9-bit literal
+		result.resize((int)((end - start) * 9 / 8 + 64));
+
+		BitWriter writer;
+		writer.out = result.data();
+		writer.put(last ? 1 : 0, 1);
+		writer.put(1, 2);
+
+		int64_t base = (start > window_size ? start - window_size : 0);
+		Vector<int32_t> head;
+		Vector<int32_t> prev;
+		head.resize(1 << hash_bits);
+		prev.resize(window_size);
+		memset(head.data(), 0xff, sizeof(int32_t) * head.size());
+
+		auto insert = [&](int64_t p)
+		{
+			if (p + min_match > total)
+				return;
+			uint32_t h = hash3(data + p);
+			prev[p & (window_size - 1)] = head[h];
+			head[h] = (int32_t)(p - base);
+		};
+
+		for (int64_t p = base; p < start; p++)
+			insert(p);
+
+		int64_t pos = start;
+		while (pos < end)
+		{
+			int best_length = 0;
+			int best_dist = 0;
+
+			if (pos + min_match <= end)
+			{
+				int limit = (int)(end - pos < max_match ? end - pos : max_match);
+				int32_t candidate = head[hash3(data + pos)];
+				int chain = max_chain;
+
+				while (candidate >= 0 && chain-- > 0)
+				{
+					int64_t from = base + candidate;
+					int64_t dist = pos - from;
+					if (dist > window_size)
+						break;
+
+					if (data[from + best_length] == data[pos + best_length])
+					{
+						int length = match_length(data + from, data + pos, limit);
+						if (length > best_length)
+						{
+							best_length = length;
+							best_dist = (int)dist;
+							if (length >= nice_length || length >= limit)
+								break;
+						}
+					}
+
+					candidate = prev[from & (window_size - 1)];
+				}
+			}
+
+			insert(pos);
+
+			if (best_length >= min_match)
+			{
+				int ls = t.length_symbol[best_length];
+				writer.put(t.lit_code[257 + ls], t.lit_bits[257 + ls]);
+				writer.put(best_length - length_base[ls], length_extra[ls]);
+
+				int ds = t.dist_symbol(best_dist);
+				writer.put(t.dist_code[ds], 5);
+				writer.put(best_dist - dist_base[ds], dist_extra[ds]);
+
+				for (int i = 1; i < best_length; i++)
+					insert(pos + i);
+
+				pos += best_length;
+			}
+			else
+			{
+				writer.put(t.lit_code[data[pos]], t.lit_bits[data[pos]]);
+				pos++;
+			}
+		}
+
+		// end of block
+		writer.put(t.lit_code[256], t.lit_bits[256]);
+
+		// sync flush, with an empty stored block
+		if (!last)
+		{
+			writer.put(0, 3);
+			writer.align();
+			*writer.out++ = 0x00;
+			*writer.out++ = 0x00;
+			*writer.out++ = 0xff;
+			*writer.out++ = 0xff;
+		}
+
+		writer.align();
+		result.resize((int)(writer.out - result.data()));
+	}
+
+	// ---------------------------------------------------------------------------------
+	// Checksums
+
+	constexpr uint32_t adler_mod = 65521;
+
+	uint32_t adler32(const uint8_t* data, int64_t length)
+	{
+		uint32_t a = 1, b = 0;
+
+		while (length > 0)
+		{
+			// the largest run that can't overflow before the modulo
+			int64_t run = (length < 5552 ? length : 5552);
+			length -= run;
+
+			while (run-- > 0)
+			{
+				a += *data++;
+				b += a;
+			}
+
+			a %= adler_mod;
+			b %= adler_mod;
+		}
+
+		return (b << 16) | a;
+	}
+
+	// Gets the adler32 of two buffers joined together, from each of their checksums
+	uint32_t adler32_combine(uint32_t first, uint32_t second, int64_t second_length)
+	{
+		uint32_t rem = (uint32_t)(second_length % adler_mod);
+		uint32_t a = first & 0xffff;
+		uint32_t b = (uint32_t)(((uint64_t)rem * a) % adler_mod);
+
+		a += (second & 0xffff) + adler_mod - 1;
+		b += ((first >> 16) & 0xffff) + ((second >> 16) & 0xffff) + adler_mod - rem;
+
+		if (a >= adler_mod) a -= adler_mod;
+		if (a >= adler_mod) a -= adler_mod;
+		if (b >= (adler_mod << 1)) b -= (adler_mod << 1);
+		if (b >= adler_mod) b -= adler_mod;
+
+		return (b << 16) | a;
+	}
+
+	uint32_t crc32(uint32_t crc, const uint8_t* data, int64_t length)
+	{
+		const uint32_t* table = tables().crc;
+
+		crc = ~crc;
+		for (int64_t i = 0; i < length; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void write_u32(uint8_t* out, uint32_t value)
+	{
+		out[0] = (uint8_t)(value >> 24);
+		out[1] = (uint8_t)(value >> 16);
+		out[2] = (uint8_t)(value >> 8);
+		out[3] = (uint8_t)value;
+	}
+
+	bool write_chunk(Stream& stream, const char* type, const uint8_t* data, int64_t length)
+	{
+		uint8_t header[8];
+		write_u32(header, (uint32_t)length);
+		memcpy(header + 4, type, 4);
+
+		uint8_t footer[4];
+		write_u32(footer, crc32(crc32(0, header + 4, 4), data, length));
+
+		return
+			stream.write(header, 8) == 8 &&
+			(length <= 0 || stream.write(data, length) == length) &&
+			stream.write(footer, 4) == 4;
+	}
+}
+
+namespace
+{
+	// Deflates the data in bands of `band_length` bytes in parallel, and returns the adler32 of all of it
+	uint32_t compress_bands(const uint8_t* data, int64_t total, int64_t band_length, Vector<Vector<uint8_t>>& bands)
+	{
+		int band_count = (int)((total + band_length - 1) / band_length);
+		Vector<uint32_t> checksums;
+		bands.resize(band_count);
+		checksums.resize(band_count);
+
+		Parallel::for_each(band_count, [&](int band)
+		{
+			int64_t start = band * band_length;
+			int64_t end = (band == band_count - 1 ? total : start + band_length);
+
+			deflate_band(data, total, start, end, band == band_count - 1, bands[band]);
+			checksums[band] = adler32(data + start, end - start);
+		});
+
+		uint32_t checksum = checksums[0];
+		for (int i = 1; i < band_count; i++)
+		{
+			int64_t length = (i == band_count - 1 ? total - i * band_length : band_length);
+			checksum = adler32_combine(checksum, checksums[i], length);
+		}
+
+		return checksum;
+	}
+}
+
+bool Png::encode(Stream& stream, const Color* pixels, int width, int height)
+{
+	if (pixels == nullptr || width <= 0 || height <= 0)
+		return false;
+
+	int row_length = width * bpp;
+	int64_t stride = (int64_t)row_length + 1;
+	int64_t total = stride * height;
+
+	int rows_per_band = (int)(band_bytes / stride);
+	if (rows_per_band < 1)
+		rows_per_band = 1;
+	int band_count = (height + rows_per_band - 1) / rows_per_band;
+
+	// filter every row
+	Vector<uint8_t> filtered;
+	filtered.resize((int)total);
+
+	Parallel::for_each(band_count, [&](int band)
+	{
+		Vector<uint8_t> scratch;
+		Vector<uint8_t> zero;
+		scratch.resize(row_length * 4);
+		zero.resize(row_length);
+		memset(zero.data(), 0, row_length);
+
+		int from = band * rows_per_band;
+		int to = (from + rows_per_band < height ? from + rows_per_band : height);
+
+		for (int y = from; y < to; y++)
+		{
+			const uint8_t* row = (const uint8_t*)(pixels + (int64_t)y * width);
+			const uint8_t* up = (y > 0 ? (const uint8_t*)(pixels + (int64_t)(y - 1) * width) : zero.data());
+			filter_row(row, up, row_length, filtered.data() + y * stride, scratch.data());
+		}
+	});
+
+	// compress each band
+	Vector<Vector<uint8_t>> bands;
+	uint32_t checksum = compress_bands(filtered.data(), total, rows_per_band * stride, bands);
+
+	// write the file
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	if (stream.write(signature, 8) != 8)
+		return false;
+
+	uint8_t header[13];
+	write_u32(header, (uint32_t)width);
+	write_u32(header + 4, (uint32_t)height);
+	header[8] = 8;	// bit depth
+	header[9] = 6;	// RGBA
+	header[10] = 0;	// deflate
+	header[11] = 0;	// adaptive filtering
+	header[12] = 0;	// no interlacing
+	if (!write_chunk(stream, "IHDR", header, 13))
+		return false;
+
+	// each band is its own IDAT chunk, with the zlib header in the first and the checksum in the last
+	for (int i = 0; i < band_count; i++)
+	{
+		Vector<uint8_t>& data = bands[i];
+
+		if (i == 0)
+		{
+			Vector<uint8_t> with_header;
+			with_header.resize(data.size() + 2);
+			with_header[0] = 0x78;
+			with_header[1] = 0x01;
+			memcpy(with_header.data() + 2, data.data(), data.size());
+			data = std::move(with_header);
+		}
+
+		if (i == band_count - 1)
+		{
+			uint8_t* end = data.expand(4);
+			write_u32(end, checksum);
+		}
+
+		if (!write_chunk(stream, "IDAT", data.data(), data.size()))
+			return false;
+
+		data.dispose();
+	}
+
+	return write_chunk(stream, "IEND", nullptr, 0);
+}
+
+bool Png::compress(Stream& stream, const void* data, int64_t length)
+{
+	if (data == nullptr || length <= 0)
+		return false;
+
+	Vector<Vector<uint8_t>> bands;
+	uint32_t checksum = compress_bands((const uint8_t*)data, length, band_bytes, bands);
+
+	const uint8_t header[2] = { 0x78, 0x01 };
+	if (stream.write(header, 2) != 2)
+		return false;
+
+	for (auto& it : bands)
+		if (stream.write(it.data(), it.size()) != it.size())
+			return false;
+
+	uint8_t footer[4];
+	write_u32(footer, checksum);
+	return stream.write(footer, 4) == 4;
+}
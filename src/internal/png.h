@@ -0,0 +1,19 @@
+#pragma once
+#include <blah/math/color.h>
+
+namespace Blah
+{
+	class Stream;
+
+	// PNG encoder used by Image::save_png.
+	// The image is split into bands of rows which are filtered and deflated in parallel,
+	// each ending with a sync flush so the compressed bands can simply be concatenated.
+	namespace Png
+	{
+		// Writes the pixels as an 8-bit RGBA PNG
+		bool encode(Stream& stream, const Color* pixels, int width, int height);
+
+		// Writes the data as a zlib stream, using the same parallel deflate encoder
+		bool compress(Stream& stream, const void* data, int64_t length);
+	}
+}
@@ -0,0 +1,636 @@
+#include <blah/streams/inflatestream.h>
+#include <blah/core/log.h>
+#include <string.h>
+
+using namespace Blah;
+
+namespace
+{
+	constexpr int window_size = 1 << 15;
+	constexpr int window_mask = window_size - 1;
+	constexpr int input_size = 4096;
+	constexpr int fast_bits = 10;
+
+	const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const uint8_t code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// A canonical Huffman code, with a lookup table for the short codes
+	struct Huffman
+	{
+		// (symbol << 4) | length, or 0 for codes longer than fast_bits
+		uint16_t fast[1 << fast_bits];
+		uint16_t counts[16];
+		uint16_t symbols[288];
+
+		bool build(const uint8_t* lengths, int count)
+		{
+			memset(counts, 0, sizeof(counts));
+			for (int i = 0; i < count; i++)
+				counts[lengths[i]]++;
+			counts[0] = 0;
+
+			// incomplete codes are allowed, over-subscribed ones aren't
+			int left = 1;
+			for (int len = 1; len < 16; len++)
+			{
+				left = (left << 1) - counts[len];
+				if (left < 0)
+					return false;
+			}
+
+			uint16_t offsets[16];
+			uint16_t next_code[16];
+			offsets[1] = 0;
+			next_code[1] = 0;
+			for (int len = 1; len < 15; len++)
+			{
+				offsets[len + 1] = offsets[len] + counts[len];
+				next_code[len + 1] = (next_code[len] + counts[len]) << 1;
+			}
+
+			memset(fast, 0, sizeof(fast));
+
+			for (int i = 0; i < count; i++)
+			{
+				int len = lengths[i];
+				if (len == 0)
+					continue;
+
+				symbols[offsets[len]++] = (uint16_t)i;
+
+				int code = next_code[len]++;
+				if (len > fast_bits)
+					continue;
+
+				// deflate stores codes starting from the most significant bit
+				int reversed = 0;
+				for (int b = 0; b < len; b++)
+					reversed |= ((code >> b) & 1) << (len - 1 - b);
+
+				for (int j = reversed; j < (1 << fast_bits); j += (1 << len))
+					fast[j] = (uint16_t)((i << 4) | len);
+			}
+
+			return true;
+		}
+
+		// decodes a code longer than fast_bits, one bit at a time
+		int decode_slow(uint64_t bits, int* length) const
+		{
+			int code = 0;
+			int first = 0;
+			int index = 0;
+
+			for (int len = 1; len < 16; len++)
+			{
+				code |= (int)((bits >> (len - 1)) & 1);
+				int count = counts[len];
+				if (code - count < first)
+				{
+					*length = len;
+					return symbols[index + (code - first)];
+				}
+
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+
+			return -1;
+		}
+	};
+}
+
+struct InflateStream::State
+{
+	enum class Block
+	{
+		Header,
+		Stored,
+		Huffman,
+		Done
+	};
+
+	Stream* source = nullptr;
+	int64_t remaining = 0;
+	int64_t position = 0;
+	bool zlib = true;
+	bool started = false;
+	bool error = false;
+
+	// compressed input, read from the source a chunk at a time
+	uint8_t input[input_size];
+	int input_position = 0;
+	int input_length = 0;
+	int overrun = 0;
+
+	uint64_t bits = 0;
+	int bit_count = 0;
+
+	Block block = Block::Header;
+	bool final = false;
+	int stored_remaining = 0;
+	int copy_length = 0;
+	int copy_distance = 0;
+
+	Huffman literals;
+	Huffman distances;
+	uint8_t window[window_size];
+
+	bool fill_input()
+	{
+		int64_t count = (remaining < input_size ? remaining : input_size);
+		count = (count > 0 ? source->read(input, count) : 0);
+		input_position = 0;
+		input_length = (int)(count > 0 ? count : 0);
+		remaining -= input_length;
+		return input_length > 0;
+	}
+
+	void refill()
+	{
+		// load a whole word at once when there's enough input
+		if (input_position + 8 <= input_length && is_little_endian())
+		{
+			uint64_t word;
+			memcpy(&word, input + input_position, sizeof(word));
+			bits |= word << bit_count;
+			input_position += (63 - bit_count) >> 3;
+			bit_count |= 56;
+			return;
+		}
+
+		while (bit_count <= 56)
+		{
+			if (input_position >= input_length && !fill_input())
+			{
+				// past the end, which is an error if any of these bits get used
+				if (++overrun > 16)
+					error = true;
+				bit_count += 8;
+				continue;
+			}
+
+			bits |= (uint64_t)input[input_position++] << bit_count;
+			bit_count += 8;
+		}
+	}
+
+	int get_bits(int count)
+	{
+		if (bit_count < count)
+			refill();
+
+		int value = (int)(bits & ((1ull << count) - 1));
+		bits >>= count;
+		bit_count -= count;
+		return value;
+	}
+
+	int decode(const Huffman& huffman)
+	{
+		if (bit_count < 16)
+		{
+			refill();
+			if (error)
+				return -1;
+		}
+
+		int length;
+		int symbol;
+		int entry = huffman.fast[bits & ((1 << fast_bits) - 1)];
+
+		if (entry != 0)
+		{
+			symbol = entry >> 4;
+			length = entry & 15;
+		}
+		else
+		{
+			symbol = huffman.decode_slow(bits, &length);
+			if (symbol < 0)
+				return -1;
+		}
+
+		bits >>= length;
+		bit_count -= length;
+		return symbol;
+	}
+
+	bool fail(const char* message)
+	{
+		Log::error("Unable to inflate: %s", message);
+		error = true;
+		block = Block::Done;
+		return false;
+	}
+
+	bool read_zlib_header()
+	{
+		int cmf = get_bits(8);
+		int flg = get_bits(8);
+
+		if ((cmf & 15) != 8 || ((cmf << 8) | flg) % 31 != 0)
+			return fail("invalid zlib header");
+		if (flg & 32)
+			return fail("preset dictionaries aren't supported");
+
+		return true;
+	}
+
+	bool read_block_header()
+	{
+		final = get_bits(1) != 0;
+		int type = get_bits(2);
+
+		// stored
+		if (type == 0)
+		{
+			get_bits(bit_count & 7);
+			int len = get_bits(16);
+			int nlen = get_bits(16);
+			if ((len ^ 0xffff) != nlen)
+				return fail("corrupt stored block");
+
+			stored_remaining = len;
+			block = Block::Stored;
+			return true;
+		}
+
+		uint8_t lengths[288 + 32];
+
+		// fixed huffman
+		if (type == 1)
+		{
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 32);
+			literals.build(lengths, 288);
+			distances.build(lengths + 288, 32);
+			block = Block::Huffman;
+			return true;
+		}
+
+		// dynamic huffman
+		if (type == 2)
+		{
+			int literal_count = get_bits(5) + 257;
+			int distance_count = get_bits(5) + 1;
+			int code_length_count = get_bits(4) + 4;
+
+			uint8_t code_lengths[19];
+			memset(code_lengths, 0, sizeof(code_lengths));
+			for (int i = 0; i < code_length_count; i++)
+				code_lengths[code_length_order[i]] = (uint8_t)get_bits(3);
+
+			Huffman code_length_code;
+			if (!code_length_code.build(code_lengths, 19))
+				return fail("corrupt code lengths");
+
+			int total = literal_count + distance_count;
+			for (int i = 0; i < total;)
+			{
+				int symbol = decode(code_length_code);
+				if (symbol < 0)
+					return fail("corrupt code lengths");
+
+				if (symbol < 16)
+				{
+					lengths[i++] = (uint8_t)symbol;
+					continue;
+				}
+
+				int repeat;
+				uint8_t value = 0;
+
+				if (symbol == 16)
+				{
+					if (i == 0)
+						return fail("corrupt code lengths");
+					value = lengths[i - 1];
+					repeat = 3 + get_bits(2);
+				}
+				else if (symbol == 17)
+					repeat = 3 + get_bits(3);
+				else
+					repeat = 11 + get_bits(7);
+
+				if (i + repeat > total)
+					return fail("corrupt code lengths");
+
+				memset(lengths + i, value, repeat);
+				i += repeat;
+			}
+
+			if (!literals.build(lengths, literal_count) || !distances.build(lengths + literal_count, distance_count))
+				return fail("corrupt huffman code");
+
+			block = Block::Huffman;
+			return true;
+		}
+
+		return fail("invalid block type");
+	}
+
+	void finish()
+	{
+		// skip the Adler-32 checksum
+		if (zlib)
+		{
+			get_bits(bit_count & 7);
+			get_bits(16);
+			get_bits(16);
+		}
+
+		if (overrun * 8 > bit_count)
+			fail("unexpected end of data");
+
+		block = Block::Done;
+	}
+
+	// decodes symbols until the output is full, or a match or the end of the block is reached
+	int64_t inflate(uint8_t* out, int64_t n, int64_t length)
+	{
+		while (n < length)
+		{
+			int symbol = decode(literals);
+
+			if (symbol < 256)
+			{
+				if (symbol < 0)
+				{
+					fail("corrupt data");
+					break;
+				}
+
+				out[n++] = (uint8_t)symbol;
+				continue;
+			}
+
+			if (symbol == 256)
+			{
+				if (final)
+					finish();
+				else
+					block = Block::Header;
+				break;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29)
+			{
+				fail("corrupt data");
+				break;
+			}
+
+			int len = length_base[symbol] + get_bits(length_extra[symbol]);
+
+			symbol = decode(distances);
+			if (symbol < 0 || symbol >= 30)
+			{
+				fail("corrupt data");
+				break;
+			}
+
+			int distance = distance_base[symbol] + get_bits(distance_extra[symbol]);
+			if (distance > position + n)
+			{
+				fail("distance is too far back");
+				break;
+			}
+
+			copy_length = len;
+			copy_distance = distance;
+			break;
+		}
+
+		return n;
+	}
+
+	// copies the pending match, from this call's output or the window before it
+	int64_t copy(uint8_t* out, int64_t n, int64_t length)
+	{
+		while (copy_length > 0 && n < length)
+		{
+			int64_t count = (copy_length < length - n ? copy_length : length - n);
+
+			if (copy_distance <= n)
+			{
+				const uint8_t* from = out + n - copy_distance;
+				if (copy_distance >= count)
+					memcpy(out + n, from, (size_t)count);
+				else
+					for (int64_t i = 0; i < count; i++)
+						out[n + i] = from[i];
+			}
+			else
+			{
+				if (count > copy_distance - n)
+					count = copy_distance - n;
+
+				int64_t from = position + n - copy_distance;
+				for (int64_t i = 0; i < count; i++)
+					out[n + i] = window[(from + i) & window_mask];
+			}
+
+			n += count;
+			copy_length -= (int)count;
+		}
+
+		return n;
+	}
+
+	int64_t stored(uint8_t* out, int64_t n, int64_t length)
+	{
+		// whole bytes still in the bit buffer come first
+		while (stored_remaining > 0 && n < length && bit_count - overrun * 8 >= 8)
+		{
+			out[n++] = (uint8_t)bits;
+			bits >>= 8;
+			bit_count -= 8;
+			stored_remaining--;
+		}
+
+		// the rest is copied straight from the input, so drop any bits a refill read ahead
+		if (stored_remaining > 0 && n < length)
+		{
+			bits = 0;
+			bit_count = 0;
+		}
+
+		while (stored_remaining > 0 && n < length)
+		{
+			if (input_position >= input_length && !fill_input())
+			{
+				fail("unexpected end of data");
+				return n;
+			}
+
+			int64_t count = input_length - input_position;
+			if (count > stored_remaining)
+				count = stored_remaining;
+			if (count > length - n)
+				count = length - n;
+
+			memcpy(out + n, input + input_position, (size_t)count);
+			input_position += (int)count;
+			stored_remaining -= (int)count;
+			n += count;
+		}
+
+		if (stored_remaining <= 0)
+		{
+			if (final)
+				finish();
+			else
+				block = Block::Header;
+		}
+
+		return n;
+	}
+
+	// keeps the end of this call's output, for matches in later calls
+	void update_window(const uint8_t* out, int64_t n)
+	{
+		int64_t count = (n < window_size ? n : window_size);
+		int64_t from = position + n - count;
+		out += n - count;
+
+		while (count > 0)
+		{
+			int offset = (int)(from & window_mask);
+			int64_t step = window_size - offset;
+			if (step > count)
+				step = count;
+
+			memcpy(window + offset, out, (size_t)step);
+			out += step;
+			from += step;
+			count -= step;
+		}
+	}
+};
+
+InflateStream::InflateStream(Stream& source, int64_t compressed_length, bool zlib)
+{
+	m_state = new State();
+	m_state->source = &source;
+	m_state->remaining = (compressed_length < 0 ? INT64_MAX : compressed_length);
+	m_state->zlib = zlib;
+}
+
+InflateStream::InflateStream(InflateStream&& src) noexcept
+{
+	m_state = src.m_state;
+	src.m_state = nullptr;
+}
+
+InflateStream& InflateStream::operator=(InflateStream&& src) noexcept
+{
+	close();
+	m_state = src.m_state;
+	src.m_state = nullptr;
+	return *this;
+}
+
+InflateStream::~InflateStream()
+{
+	close();
+}
+
+int64_t InflateStream::length() const
+{
+	return position();
+}
+
+int64_t InflateStream::position() const
+{
+	return (m_state ? m_state->position : 0);
+}
+
+int64_t InflateStream::seek(int64_t seek_to)
+{
+	char buffer[4096];
+
+	while (m_state && m_state->position < seek_to)
+	{
+		int64_t step = seek_to - m_state->position;
+		if (step > (int64_t)sizeof(buffer))
+			step = sizeof(buffer);
+
+		if (read_into(buffer, step) <= 0)
+			break;
+	}
+
+	return position();
+}
+
+bool InflateStream::is_open() const
+{
+	return m_state != nullptr;
+}
+
+void InflateStream::close()
+{
+	delete m_state;
+	m_state = nullptr;
+}
+
+bool InflateStream::is_finished() const
+{
+	return m_state == nullptr || m_state->block == State::Block::Done;
+}
+
+bool InflateStream::has_error() const
+{
+	return m_state != nullptr && m_state->error;
+}
+
+int64_t InflateStream::read_into(void* ptr, int64_t length)
+{
+	if (m_state == nullptr || ptr == nullptr || length <= 0)
+		return 0;
+
+	auto& s = *m_state;
+	auto out = (uint8_t*)ptr;
+	int64_t n = 0;
+
+	if (!s.started)
+	{
+		s.started = true;
+		if (s.zlib)
+			s.read_zlib_header();
+	}
+
+	while (n < length && !s.error)
+	{
+		if (s.copy_length > 0)
+		{
+			n = s.copy(out, n, length);
+			continue;
+		}
+
+		if (s.block == State::Block::Done)
+			break;
+		else if (s.block == State::Block::Header)
+			s.read_block_header();
+		else if (s.block == State::Block::Stored)
+			n = s.stored(out, n, length);
+		else
+			n = s.inflate(out, n, length);
+	}
+
+	s.update_window(out, n);
+	s.position += n;
+	return n;
+}
+
+int64_t InflateStream::write_from(const void*, int64_t)
+{
+	return 0;
+}